@@ -0,0 +1,34 @@
+/*
+ * aligned.h
+ *
+ *  Created on: 19/10/2026
+ *      Author: clinton
+ */
+
+#ifndef ALIGNED_H_
+#define ALIGNED_H_
+
+#include <stdlib.h>
+#include <stdint.h>
+
+// Alignment wide enough for the widest vector loads we let the compiler use.
+#define ALIGNED_BYTES 32
+
+// malloc() with the result aligned to ALIGNED_BYTES. The offset to the real
+// allocation is kept in the byte before the returned pointer, so it must be
+// released with aligned_free().
+static inline void* aligned_malloc(size_t size) {
+	unsigned char* raw = malloc(size + ALIGNED_BYTES);
+	if (raw == 0) { return 0; }
+	unsigned char* r = (unsigned char*)(((uintptr_t)raw + ALIGNED_BYTES) & ~(uintptr_t)(ALIGNED_BYTES - 1));
+	r[-1] = (unsigned char)(r - raw);
+	return r;
+}
+
+static inline void aligned_free(void* ptr) {
+	if (ptr == 0) { return; }
+	unsigned char* r = (unsigned char*)ptr;
+	free(r - r[-1]);
+}
+
+#endif /* ALIGNED_H_ */
@@ -0,0 +1,265 @@
+/*
+ * ambient_cache.c
+ *
+ *  Created on: 19/10/2026
+ *      Author: clinton
+ */
+
+#include <malloc.h>
+#include <memory.h>
+#include <stdlib.h>
+#include <math.h>
+#include "ambient_cache.h"
+#include "util.h"
+
+#define AMBIENT_CACHE_SLOTS (1 << AMBIENT_CACHE_SLOT_BITS)
+
+// Cells are indexed from -AMBIENT_CACHE_EXTENT to AMBIENT_CACHE_EXTENT on
+// each axis. Points further out aren't cached.
+#define AMBIENT_CACHE_EXTENT (1 << 20)
+
+// Occlusion rays start this far off the surface along its normal.
+#define AMBIENT_OFFSET 0.1
+
+// A value traced at one point, which never changes once it's in a list.
+typedef struct {
+	Vec3 point;
+	Vec3 normal;
+	FPType radius;
+	FPType open;
+	int next; // in its cell's list, or -1
+}AmbientRecord;
+
+struct _AmbientCache {
+	const Scene* scene;
+	int scene_id; // of what it was filled for, as the scene may be freed
+	int samples;
+	// Committed, each in its cell's list. Only commits change them.
+	AmbientRecord* records;
+	int record_count;
+	// First record of the cells that hash to each slot, or -1. Cells that
+	// hash to the same slot share a list.
+	int* heads;
+	// Waiting for the next commit.
+	AmbientRecord* pending;
+	volatile int pending_count; // may run past AMBIENT_CACHE_MAX_PENDING
+};
+
+// What a thread traced since ambient_cache_local_begin().
+typedef struct {
+	const AmbientCache* cache; // 0 outside ambient_cache_local_begin() and end
+	int count;
+	AmbientRecord records[AMBIENT_CACHE_LOCAL_RECORDS];
+}AmbientLocal;
+
+static __thread AmbientLocal ambient_local;
+
+AmbientCache* ambient_cache_new() {
+	AmbientCache* cache = malloc(sizeof(AmbientCache));
+	cache->scene = 0;
+	cache->scene_id = 0;
+	cache->samples = 0;
+	cache->records = malloc(sizeof(AmbientRecord) * AMBIENT_CACHE_MAX_RECORDS);
+	cache->record_count = 0;
+	cache->heads = malloc(sizeof(int) * AMBIENT_CACHE_SLOTS);
+	memset(cache->heads, 0xff, sizeof(int) * AMBIENT_CACHE_SLOTS);
+	cache->pending = malloc(sizeof(AmbientRecord) * AMBIENT_CACHE_MAX_PENDING);
+	cache->pending_count = 0;
+	return cache;
+}
+
+void ambient_cache_free(AmbientCache* cache) {
+	free(cache->records);
+	free(cache->heads);
+	free(cache->pending);
+	free(cache);
+}
+
+void ambient_cache_update(AmbientCache* cache, const Scene* scene, int samples) {
+	// The address may be reused by a new scene, but never the id.
+	const int id = scene != 0 ? scene_id(scene) : 0;
+	cache->scene = scene;
+	if (cache->scene_id == id && cache->samples == samples) { return; }
+	cache->scene_id = id;
+	cache->samples = samples;
+	cache->record_count = 0;
+	memset(cache->heads, 0xff, sizeof(int) * AMBIENT_CACHE_SLOTS);
+	cache->pending_count = 0;
+}
+
+static int ambient_cache_slot(int x, int y, int z) {
+	unsigned int h = hash_uint((unsigned int)x);
+	h = hash_uint(h ^ (unsigned int)y);
+	h = hash_uint(h ^ (unsigned int)z);
+	return (int)(h >> (32 - AMBIENT_CACHE_SLOT_BITS));
+}
+
+// The cell point is in, or 0 if it's too far out to cache.
+static int ambient_cache_cell(const Vec3* point, int* x, int* y, int* z) {
+	const FPType size = (FPType)AMBIENT_CACHE_CELL_SIZE;
+	const FPType extent = (FPType)AMBIENT_CACHE_EXTENT;
+	FPType fx = floor(point->x / size);
+	FPType fy = floor(point->y / size);
+	FPType fz = floor(point->z / size);
+	if (!(fabs(fx) <= extent && fabs(fy) <= extent && fabs(fz) <= extent)) { return 0; }
+	*x = (int)fx;
+	*y = (int)fy;
+	*z = (int)fz;
+	return 1;
+}
+
+// Orders records by where they are and which way they face, which decides
+// the order they're summed in by a query.
+static int ambient_record_compare(const void* a, const void* b) {
+	const AmbientRecord* ra = a;
+	const AmbientRecord* rb = b;
+	const FPType ka[6] = {ra->point.x, ra->point.y, ra->point.z, ra->normal.x, ra->normal.y, ra->normal.z};
+	const FPType kb[6] = {rb->point.x, rb->point.y, rb->point.z, rb->normal.x, rb->normal.y, rb->normal.z};
+	for (int i = 0; i < 6; ++i) {
+		if (ka[i] < kb[i]) { return -1; }
+		if (ka[i] > kb[i]) { return 1; }
+	}
+	return 0;
+}
+
+void ambient_cache_commit(AmbientCache* cache) {
+	const int count = cache->pending_count;
+	if (count == 0) { return; }
+	cache->pending_count = 0;
+	// Which records made it in before it filled depends on which worker
+	// got there first, so if any didn't, none are kept.
+	if (count > AMBIENT_CACHE_MAX_PENDING) { return; }
+	// A record's value only depends on where it is, so sorted they're the
+	// same whatever order the workers traced them in. Records in the same
+	// place are the same record. So once the cache is nearly full, which
+	// of them fit doesn't depend on the order either.
+	qsort(cache->pending, count, sizeof(AmbientRecord), ambient_record_compare);
+	const int room = AMBIENT_CACHE_MAX_RECORDS - cache->record_count;
+	const int added = count < room ? count : room;
+	for (int i = 0; i < added; ++i) {
+		const int index = cache->record_count + i;
+		AmbientRecord* record = &cache->records[index];
+		*record = cache->pending[i];
+		int x, y, z;
+		ambient_cache_cell(&record->point, &x, &y, &z);
+		int slot = ambient_cache_slot(x, y, z);
+		record->next = cache->heads[slot];
+		cache->heads[slot] = index;
+	}
+	cache->record_count += added;
+}
+
+void ambient_cache_local_begin(AmbientCache* cache) {
+	ambient_local.cache = cache;
+	ambient_local.count = 0;
+}
+
+void ambient_cache_local_end(AmbientCache* cache) {
+	ambient_local.cache = 0;
+	ambient_local.count = 0;
+}
+
+FPType ambient_occlusion(const Scene* scene, const Vec3* point, const Vec3* normal, int samples, unsigned int seed, FPType* radius) {
+	// Any two directions across the normal will do.
+	Vec3 axis = fabs(normal->x) < (FPType)0.5 ? (Vec3){1,0,0} : (Vec3){0,1,0};
+	Vec3 tangent = vec3_cross(normal, &axis);
+	tangent = vec3_normalize(&tangent);
+	Vec3 bitangent = vec3_cross(normal, &tangent);
+	Vec3 offset = vec3_scale(normal, (FPType)AMBIENT_OFFSET);
+	Vec3 origin = vec3_add(point, &offset);
+	int open = 0;
+	FPType inverse_distances = 0;
+	for (int i = 0; i < samples; ++i) {
+		// Stratified in how far from the normal the ray goes. Picking a
+		// point on the unit disc and lifting it onto the hemisphere gives
+		// directions weighted to the cosine.
+		FPType u1 = ((FPType)i + hash_unit(hash_uint(seed + 2 * i))) / (FPType)samples;
+		FPType u2 = hash_unit(hash_uint(seed + 2 * i + 1));
+		FPType r = sqrt(u1);
+		FPType phi = (FPType)(2 * M_PI) * u2;
+		Vec3 t = vec3_scale(&tangent, r * cos(phi));
+		Vec3 b = vec3_scale(&bitangent, r * sin(phi));
+		Vec3 n = vec3_scale(normal, sqrt((FPType)1 - u1));
+		Vec3 direction = vec3_add(&t, &b);
+		direction = vec3_add(&direction, &n);
+		Ray ray = ray_init(&origin, &direction);
+		FPType time;
+		if (scene_is_ray_blocked(scene, &ray, (FPType)AMBIENT_DISTANCE, &time)) {
+			inverse_distances += (FPType)1 / fmax(time, (FPType)AMBIENT_OFFSET);
+		} else {
+			++open;
+			inverse_distances += (FPType)1 / (FPType)AMBIENT_DISTANCE;
+		}
+	}
+	*radius = samples > 0 ? (FPType)samples / inverse_distances : (FPType)AMBIENT_DISTANCE;
+	return samples > 0 ? (FPType)open / (FPType)samples : (FPType)1;
+}
+
+// How much the record counts towards the value at point, or 0 if it's too
+// far off to use. It falls to 0 at the edge of where it's used, so points
+// don't change value suddenly as records come and go from the average.
+static FPType ambient_cache_weight(const AmbientRecord* record, const Vec3* point, const Vec3* normal) {
+	Vec3 v = vec3_sub(point, &record->point);
+	Vec3 normals = vec3_add(normal, &record->normal);
+	// The record is in front of the point, so its rays saw less of what's
+	// around the point than the point does.
+	if (vec3_dot(&v, &normals) < (FPType)(-0.1 * AMBIENT_OFFSET)) { return 0; }
+	FPType c = vec3_dot(normal, &record->normal);
+	if (c > (FPType)1) { c = (FPType)1; }
+	FPType error = vec3_length(&v) / record->radius + sqrt((FPType)1 - c);
+	if (!(error < (FPType)AMBIENT_CACHE_ERROR)) { return 0; }
+	return (FPType)1 / fmax(error, (FPType)1e-3) - (FPType)1 / (FPType)AMBIENT_CACHE_ERROR;
+}
+
+FPType ambient_cache_query(AmbientCache* cache, const Vec3* point, const Vec3* normal, unsigned int seed, int* rays, int* cached) {
+	int x, y, z;
+	const int in_range = cache->scene != 0 && ambient_cache_cell(point, &x, &y, &z);
+	AmbientLocal* local = ambient_local.cache == cache ? &ambient_local : 0;
+	if (in_range) {
+		FPType total_weight = 0, total = 0;
+		int slots[27];
+		for (int i = 0; i < 27; ++i) {
+			slots[i] = ambient_cache_slot(x + i % 3 - 1, y + (i / 3) % 3 - 1, z + i / 9 - 1);
+			// Neighbouring cells can share a list, which is only summed once.
+			int seen = 0;
+			for (int j = 0; j < i && !seen; ++j) {
+				seen = slots[j] == slots[i];
+			}
+			if (seen) { continue; }
+			for (int r = cache->heads[slots[i]]; r >= 0; r = cache->records[r].next) {
+				FPType w = ambient_cache_weight(&cache->records[r], point, normal);
+				total_weight += w;
+				total += w * cache->records[r].open;
+			}
+		}
+		if (total_weight == (FPType)0 && local != 0) {
+			for (int r = 0; r < local->count; ++r) {
+				FPType w = ambient_cache_weight(&local->records[r], point, normal);
+				total_weight += w;
+				total += w * local->records[r].open;
+			}
+		}
+		if (total_weight > (FPType)0) {
+			++*cached;
+			return total / total_weight;
+		}
+	}
+
+	const int samples = cache->scene != 0 ? cache->samples : 0;
+	FPType radius;
+	FPType open = ambient_occlusion(cache->scene, point, normal, samples, seed, &radius);
+	*rays += samples;
+	if (!in_range) { return open; }
+	if (radius < (FPType)AMBIENT_CACHE_MIN_RADIUS) { radius = (FPType)AMBIENT_CACHE_MIN_RADIUS; }
+	if (radius > (FPType)AMBIENT_CACHE_MAX_RADIUS) { radius = (FPType)AMBIENT_CACHE_MAX_RADIUS; }
+	const AmbientRecord record = (AmbientRecord){*point, *normal, radius, open, -1};
+	if (local != 0 && local->count < AMBIENT_CACHE_LOCAL_RECORDS) {
+		local->records[local->count++] = record;
+	}
+	// Left out of the lists until it's committed.
+	int index = __sync_fetch_and_add(&cache->pending_count, 1);
+	if (index < AMBIENT_CACHE_MAX_PENDING) {
+		cache->pending[index] = record;
+	}
+	return open;
+}
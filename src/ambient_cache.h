@@ -0,0 +1,92 @@
+/*
+ * ambient_cache.h
+ *
+ *  Created on: 19/10/2026
+ *      Author: clinton
+ */
+
+#ifndef AMBIENT_CACHE_H_
+#define AMBIENT_CACHE_H_
+
+#include "types.h"
+#include "vec3.h"
+#include "scene.h"
+
+// Occlusion rays only look this far, so only nearby surfaces darken a point.
+#define AMBIENT_DISTANCE 60.0
+
+// A cached value is used for a point when its distance from where the value
+// was traced, over the value's radius, plus a term for how far apart their
+// normals are, comes to less than this. Lower traces more and smooths less.
+#define AMBIENT_CACHE_ERROR 0.4
+
+// Limits on a value's radius, which is the harmonic mean of the distances
+// its rays went, so values in corners cover less than those in the open.
+#define AMBIENT_CACHE_MIN_RADIUS 2.0
+#define AMBIENT_CACHE_MAX_RADIUS 30.0
+
+// Edge length of a cell of the grid values are found through. At least
+// AMBIENT_CACHE_ERROR * AMBIENT_CACHE_MAX_RADIUS, so any value a point can
+// use is in its cell or a neighbour.
+#define AMBIENT_CACHE_CELL_SIZE 12.0
+
+// Cells hash to 1 << AMBIENT_CACHE_SLOT_BITS lists of the values in them.
+#define AMBIENT_CACHE_SLOT_BITS 16
+
+// Once this many values are cached, points no value covers are traced
+// without being cached.
+#define AMBIENT_CACHE_MAX_RECORDS (1 << 19)
+
+// Values traced between commits are held for the next one, up to this many,
+// which is more than a 640 x 480 frame's pixels. If more are traced, none of
+// them are committed.
+#define AMBIENT_CACHE_MAX_PENDING (1 << 19)
+
+// Values a thread keeps for its own queries until the next commit, between
+// ambient_cache_local_begin() and ambient_cache_local_end().
+#define AMBIENT_CACHE_LOCAL_RECORDS 64
+
+// Ambient occlusion, the fraction of the hemisphere above a point that's
+// open within AMBIENT_DISTANCE, kept in world space so it outlives the view.
+// It changes slowly over a surface, so values are only traced where no
+// value already cached is close enough, and points between them take a
+// weighted average of those around them. Safe to query from several
+// threads at once. Values traced by queries are only used by other threads'
+// queries after the next commit, which adds them in an order of their own,
+// so what a query returns doesn't depend on how the queries before it were
+// shared out between threads.
+typedef struct _AmbientCache AmbientCache;
+
+AmbientCache* ambient_cache_new();
+void ambient_cache_free(AmbientCache* cache);
+
+// Drops everything cached if the scene or the rays traced per value changed
+// since it was filled. Not safe while it's being queried.
+void ambient_cache_update(AmbientCache* cache, const Scene* scene, int samples);
+
+// Makes the values traced since the last commit available to queries. Not
+// safe while it's being queried.
+void ambient_cache_commit(AmbientCache* cache);
+
+// Until ambient_cache_local_end(), the calling thread's queries also use the
+// values it traced itself since it called this, where no committed value
+// covers the point. The first few a region needs then stand in for the rest
+// before they're committed. Only for runs of queries made in an order that
+// doesn't depend on timing, such as a tile's pixels, so what they return
+// doesn't either.
+void ambient_cache_local_begin(AmbientCache* cache);
+void ambient_cache_local_end(AmbientCache* cache);
+
+// Open fraction at point, on a surface facing normal, from the values cached
+// around it or traced there if there aren't any. seed picks the directions
+// of the rays if it's traced. *rays is increased by the occlusion rays
+// traced, and *cached by 1 if none were.
+FPType ambient_cache_query(AmbientCache* cache, const Vec3* point, const Vec3* normal, unsigned int seed, int* rays, int* cached);
+
+// Traces samples occlusion rays over the hemisphere above point, weighted
+// to the cosine of their angle to normal, and returns the fraction that
+// weren't blocked. The harmonic mean distance they went is written to
+// *radius.
+FPType ambient_occlusion(const Scene* scene, const Vec3* point, const Vec3* normal, int samples, unsigned int seed, FPType* radius);
+
+#endif /* AMBIENT_CACHE_H_ */
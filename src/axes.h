@@ -108,18 +108,35 @@ static inline Vec3 point_from_space(const Vec3* point, const Axes* space) {
 	};
 }
 
-static inline Ray ray_to_space(const Ray* ray, const Axes* space) {
+// The axes are only ever rotated and moved, so a ray keeps its length going
+// in or out of a space and its unit flag carries over. Only the reciprocals
+// have to be redone, and the octant is read off the signs of the new
+// direction rather than waiting on them.
+static inline Ray ray_moved(const Ray* ray, const Vec3* origin, const Vec3* direction) {
 	return (Ray){
-		.origin = point_to_space(&ray->origin, space),
-		.direction = vector_to_space(&ray->direction, space)
+		.origin = *origin,
+		.direction = *direction,
+		.inv_direction = (Vec3){
+			(FPType)1 / direction->x,
+			(FPType)1 / direction->y,
+			(FPType)1 / direction->z
+		},
+		// signbit() so -0 counts as negative, matching its -inf.
+		.octant = (signbit(direction->x) != 0) | ((signbit(direction->y) != 0) << 1) | ((signbit(direction->z) != 0) << 2),
+		.unit = ray->unit
 	};
 }
 
+static inline Ray ray_to_space(const Ray* ray, const Axes* space) {
+	Vec3 origin = point_to_space(&ray->origin, space);
+	Vec3 direction = vector_to_space(&ray->direction, space);
+	return ray_moved(ray, &origin, &direction);
+}
+
 static inline Ray ray_from_space(const Ray* ray, const Axes* space) {
-	return (Ray){
-		.origin = point_from_space(&ray->origin, space),
-		.direction = vector_from_space(&ray->direction, space)
-	};
+	Vec3 origin = point_from_space(&ray->origin, space);
+	Vec3 direction = vector_from_space(&ray->direction, space);
+	return ray_moved(ray, &origin, &direction);
 }
 
 static inline Axes axes_to_space(const Axes* axes, const Axes* space) {
@@ -0,0 +1,185 @@
+/*
+ * bounds.h
+ *
+ *  Created on: 19/10/2026
+ *      Author: clinton
+ */
+
+#ifndef BOUNDS_H_
+#define BOUNDS_H_
+
+#include <math.h>
+#include "types.h"
+#include "vec3.h"
+#include "ray.h"
+#include "axes.h"
+#include "plane.h"
+#include "sphere.h"
+
+// Axis aligned bounds. Components may be infinite so half-spaces and planes
+// can still be bounded along the axis their normal points down. An empty
+// bounds has min > max on every axis.
+typedef struct {
+	Vec3 min, max;
+}Bounds;
+
+// Padding applied when bounds are derived numerically so the surfaces they
+// enclose never fall just outside them.
+static const FPType bounds_epsilon = (FPType)0.01;
+
+static inline Bounds bounds_init(const Vec3* min, const Vec3* max) {
+	return (Bounds){*min, *max};
+}
+
+static inline Bounds bounds_infinite() {
+	return (Bounds){
+		(Vec3){-INFINITY, -INFINITY, -INFINITY},
+		(Vec3){INFINITY, INFINITY, INFINITY}
+	};
+}
+
+static inline Bounds bounds_empty() {
+	return (Bounds){
+		(Vec3){INFINITY, INFINITY, INFINITY},
+		(Vec3){-INFINITY, -INFINITY, -INFINITY}
+	};
+}
+
+static inline int bounds_is_empty(const Bounds* bounds) {
+	return bounds->min.x > bounds->max.x || bounds->min.y > bounds->max.y || bounds->min.z > bounds->max.z;
+}
+
+static inline int bounds_is_finite(const Bounds* bounds) {
+	return isfinite(bounds->min.x) && isfinite(bounds->min.y) && isfinite(bounds->min.z) &&
+		isfinite(bounds->max.x) && isfinite(bounds->max.y) && isfinite(bounds->max.z);
+}
+
+static inline Bounds bounds_union(const Bounds* a, const Bounds* b) {
+	if (bounds_is_empty(a)) { return *b; }
+	if (bounds_is_empty(b)) { return *a; }
+	return (Bounds){
+		(Vec3){fmin(a->min.x, b->min.x), fmin(a->min.y, b->min.y), fmin(a->min.z, b->min.z)},
+		(Vec3){fmax(a->max.x, b->max.x), fmax(a->max.y, b->max.y), fmax(a->max.z, b->max.z)}
+	};
+}
+
+static inline Bounds bounds_intersect(const Bounds* a, const Bounds* b) {
+	return (Bounds){
+		(Vec3){fmax(a->min.x, b->min.x), fmax(a->min.y, b->min.y), fmax(a->min.z, b->min.z)},
+		(Vec3){fmin(a->max.x, b->max.x), fmin(a->max.y, b->max.y), fmin(a->max.z, b->max.z)}
+	};
+}
+
+static inline Bounds bounds_pad(const Bounds* bounds, FPType amount) {
+	return (Bounds){
+		(Vec3){bounds->min.x - amount, bounds->min.y - amount, bounds->min.z - amount},
+		(Vec3){bounds->max.x + amount, bounds->max.y + amount, bounds->max.z + amount}
+	};
+}
+
+static inline FPType bounds_surface_area(const Bounds* bounds) {
+	if (bounds_is_empty(bounds)) { return (FPType)0; }
+	FPType dx = bounds->max.x - bounds->min.x;
+	FPType dy = bounds->max.y - bounds->min.y;
+	FPType dz = bounds->max.z - bounds->min.z;
+	// Checked up front as a flat side would otherwise give 0*inf.
+	if (isinf(dx) || isinf(dy) || isinf(dz)) { return INFINITY; }
+	return (FPType)2 * (dx*dy + dy*dz + dz*dx);
+}
+
+static inline int bounds_contains_point(const Bounds* bounds, const Vec3* point) {
+	return
+		bounds->min.x <= point->x && point->x <= bounds->max.x &&
+		bounds->min.y <= point->y && point->y <= bounds->max.y &&
+		bounds->min.z <= point->z && point->z <= bounds->max.z;
+}
+
+static __attribute__((unused)) Bounds bounds_from_sphere(const Sphere* sphere) {
+	FPType r = sphere->radius + bounds_epsilon;
+	return (Bounds){
+		(Vec3){sphere->centre.x - r, sphere->centre.y - r, sphere->centre.z - r},
+		(Vec3){sphere->centre.x + r, sphere->centre.y + r, sphere->centre.z + r}
+	};
+}
+
+// Returns the axis (0, 1 or 2) a plane's normal lies along, or -1 if the
+// plane is not axis aligned.
+static inline int bounds_plane_axis(const Plane* plane) {
+	if (plane->n.y == (FPType)0 && plane->n.z == (FPType)0 && plane->n.x != (FPType)0) { return 0; }
+	if (plane->n.x == (FPType)0 && plane->n.z == (FPType)0 && plane->n.y != (FPType)0) { return 1; }
+	if (plane->n.x == (FPType)0 && plane->n.y == (FPType)0 && plane->n.z != (FPType)0) { return 2; }
+	return -1;
+}
+
+static __attribute__((unused)) Bounds bounds_from_plane(const Plane* plane) {
+	Bounds r = bounds_infinite();
+	int axis = bounds_plane_axis(plane);
+	if (axis != -1) {
+		FPType n = (&plane->n.x)[axis];
+		FPType at = -plane->d / n;
+		(&r.min.x)[axis] = at - bounds_epsilon;
+		(&r.max.x)[axis] = at + bounds_epsilon;
+	}
+	return r;
+}
+
+// Bounds of the solid side of a half-space (n.p + d <= 0), or of the other
+// side if complement is non-zero.
+static __attribute__((unused)) Bounds bounds_from_half_space(const Plane* plane, int complement) {
+	Bounds r = bounds_infinite();
+	int axis = bounds_plane_axis(plane);
+	if (axis != -1) {
+		FPType n = (&plane->n.x)[axis];
+		FPType at = -plane->d / n;
+		if ((n > (FPType)0) != (complement != 0)) {
+			(&r.max.x)[axis] = at + bounds_epsilon;
+		} else {
+			(&r.min.x)[axis] = at - bounds_epsilon;
+		}
+	}
+	return r;
+}
+
+// Bounds in the parent space of bounds given in the local space of "space".
+static __attribute__((unused)) Bounds bounds_from_space(const Bounds* bounds, const Axes* space) {
+	if (bounds_is_empty(bounds)) { return *bounds; }
+	if (!bounds_is_finite(bounds)) { return bounds_infinite(); }
+	Bounds r = bounds_empty();
+	for (int i = 0; i < 8; ++i) {
+		Vec3 corner = (Vec3){
+			(i & 1) ? bounds->max.x : bounds->min.x,
+			(i & 2) ? bounds->max.y : bounds->min.y,
+			(i & 4) ? bounds->max.z : bounds->min.z
+		};
+		corner = point_from_space(&corner, space);
+		Bounds p = (Bounds){corner, corner};
+		r = bounds_union(&r, &p);
+	}
+	return bounds_pad(&r, bounds_epsilon);
+}
+
+// Slab test. Returns non-zero if the ray passes through the bounds at some
+// time >= 0, with the entry and exit times written to t_near and t_far.
+static inline int bounds_ray_range(const Bounds* bounds, const Ray* ray, FPType* t_near, FPType* t_far) {
+	FPType t0 = -INFINITY;
+	FPType t1 = INFINITY;
+	const FPType* o = &ray->origin.x;
+	const FPType* inv_d = &ray->inv_direction.x;
+	const FPType* min = &bounds->min.x;
+	const FPType* max = &bounds->max.x;
+	for (int i = 0; i < 3; ++i) {
+		// The octant picks which side is entered first. An axis the ray
+		// doesn't move on gives +-inf, or NaN exactly on a side, and the
+		// comparisons below ignore NaN.
+		int negative = (ray->octant >> i) & 1;
+		FPType ta = ((negative ? max : min)[i] - o[i]) * inv_d[i];
+		FPType tb = ((negative ? min : max)[i] - o[i]) * inv_d[i];
+		if (ta > t0) { t0 = ta; }
+		if (tb < t1) { t1 = tb; }
+	}
+	*t_near = t0;
+	*t_far = t1;
+	return t0 <= t1 && t1 >= (FPType)0;
+}
+
+#endif /* BOUNDS_H_ */
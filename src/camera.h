@@ -52,6 +52,29 @@ static inline Ray camera_screen_coord_to_ray(const Camera* camera, int coordX, i
 	);
 }
 
+// Inverse of camera_screen_coord_to_ray(). Writes the screen coordinates a
+// world space point projects to and returns non-zero if it is in front of
+// the camera.
+static inline int camera_point_to_screen_coord(const Camera* camera, const Vec3* point, int screenWidth, int screenHeight, FPType* coordX, FPType* coordY) {
+	Vec3 p = point_to_space(point, &camera->axes);
+	if (p.z >= (FPType)0) { return 0; }
+	FPType s = camera->screen_depth / -p.z;
+	*coordX = p.x * s + screenWidth/2;
+	*coordY = screenHeight/2 - p.y * s;
+	return 1;
+}
+
+// Same as camera_point_to_screen_coord() for a direction, i.e. a point
+// infinitely far away.
+static inline int camera_direction_to_screen_coord(const Camera* camera, const Vec3* direction, int screenWidth, int screenHeight, FPType* coordX, FPType* coordY) {
+	Vec3 d = vector_to_space(direction, &camera->axes);
+	if (d.z >= (FPType)0) { return 0; }
+	FPType s = camera->screen_depth / -d.z;
+	*coordX = d.x * s + screenWidth/2;
+	*coordY = screenHeight/2 - d.y * s;
+	return 1;
+}
+
 static inline Text* camera_screen_coord_to_ray_glsl_code() {
 	return text(
 		"void screen_coord_to_ray(in vec2 coord, out vec3 ro, out vec3 rd) {\n"
@@ -0,0 +1,121 @@
+/*
+ * camera_rays.c
+ *
+ *  Created on: 19/10/2026
+ *      Author: clinton
+ */
+
+#include <math.h>
+#include <malloc.h>
+#include "aligned.h"
+#include "camera_rays.h"
+
+struct _CameraRays {
+	int screen_width;
+	int screen_height;
+	FPType screen_depth;
+	// Structure of arrays, one entry per pixel in row major order.
+	FPType* x;
+	FPType* y;
+	FPType* z;
+};
+
+CameraRays* camera_rays_new() {
+	CameraRays* rays = malloc(sizeof(CameraRays));
+	rays->screen_width = 0;
+	rays->screen_height = 0;
+	rays->screen_depth = 0;
+	rays->x = 0;
+	rays->y = 0;
+	rays->z = 0;
+	return rays;
+}
+
+void camera_rays_free(CameraRays* rays) {
+	aligned_free(rays->x);
+	aligned_free(rays->y);
+	aligned_free(rays->z);
+	free(rays);
+}
+
+void camera_rays_update(CameraRays* rays, int screen_width, int screen_height, FPType screen_depth) {
+	if (rays->screen_width == screen_width && rays->screen_height == screen_height && rays->screen_depth == screen_depth) {
+		return;
+	}
+	if (rays->screen_width * rays->screen_height != screen_width * screen_height) {
+		size_t size = sizeof(FPType) * screen_width * screen_height;
+		aligned_free(rays->x);
+		aligned_free(rays->y);
+		aligned_free(rays->z);
+		rays->x = aligned_malloc(size);
+		rays->y = aligned_malloc(size);
+		rays->z = aligned_malloc(size);
+	}
+	rays->screen_width = screen_width;
+	rays->screen_height = screen_height;
+	rays->screen_depth = screen_depth;
+	int i = 0;
+	for (int y = 0; y < screen_height; ++y) {
+		for (int x = 0; x < screen_width; ++x, ++i) {
+			// Same integer centring as camera_screen_coord_to_ray().
+			Vec3 rd = (Vec3){x - screen_width/2, screen_height/2 - y, -screen_depth};
+			rd = vec3_scale(&rd, (FPType)1.0 / vec3_length(&rd));
+			rays->x[i] = rd.x;
+			rays->y[i] = rd.y;
+			rays->z[i] = rd.z;
+		}
+	}
+}
+
+void camera_rays_row(const CameraRays* rays, const Camera* camera, int x, int y, int count, FPType* restrict dx, FPType* restrict dy, FPType* restrict dz) {
+	const int offset = y * rays->screen_width + x;
+	const FPType* restrict cx = rays->x + offset;
+	const FPType* restrict cy = rays->y + offset;
+	const FPType* restrict cz = rays->z + offset;
+	const Vec3 u = camera->axes.u;
+	const Vec3 v = camera->axes.v;
+	const Vec3 w = camera->axes.w;
+	// Plain multiply-adds over the arrays, which the compiler vectorises.
+	for (int i = 0; i < count; ++i) {
+		dx[i] = u.x * cx[i] + v.x * cy[i] + w.x * cz[i];
+		dy[i] = u.y * cx[i] + v.y * cy[i] + w.y * cz[i];
+		dz[i] = u.z * cx[i] + v.z * cy[i] + w.z * cz[i];
+	}
+}
+
+void camera_rays_row_jittered(const CameraRays* rays, const Camera* camera, int x, int y, int count, FPType jitter_x, FPType jitter_y, FPType* restrict dx, FPType* restrict dy, FPType* restrict dz) {
+	const FPType depth = rays->screen_depth;
+	const FPType py = (FPType)(rays->screen_height/2) - ((FPType)y + jitter_y);
+	const FPType px0 = (FPType)x + jitter_x - (FPType)(rays->screen_width/2);
+	const Vec3 u = camera->axes.u;
+	const Vec3 v = camera->axes.v;
+	const Vec3 w = camera->axes.w;
+	for (int i = 0; i < count; ++i) {
+		FPType px = px0 + (FPType)i;
+		FPType s = (FPType)1 / sqrt(px*px + py*py + depth*depth);
+		FPType cx = px * s;
+		FPType cy = py * s;
+		FPType cz = -depth * s;
+		dx[i] = u.x * cx + v.x * cy + w.x * cz;
+		dy[i] = u.y * cx + v.y * cy + w.y * cz;
+		dz[i] = u.z * cx + v.z * cy + w.z * cz;
+	}
+}
+
+Ray camera_rays_ray(const CameraRays* rays, const Camera* camera, int x, int y) {
+	int i = y * rays->screen_width + x;
+	Vec3 c = (Vec3){rays->x[i], rays->y[i], rays->z[i]};
+	Vec3 rd = vector_from_space(&c, &camera->axes);
+	return ray_init(&camera->axes.o, &rd);
+}
+
+Ray camera_rays_ray_jittered(const CameraRays* rays, const Camera* camera, FPType x, FPType y) {
+	Vec3 c = (Vec3){
+		x - (FPType)(rays->screen_width/2),
+		(FPType)(rays->screen_height/2) - y,
+		-rays->screen_depth
+	};
+	c = vec3_normalize(&c);
+	Vec3 rd = vector_from_space(&c, &camera->axes);
+	return ray_init(&camera->axes.o, &rd);
+}
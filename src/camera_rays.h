@@ -0,0 +1,37 @@
+/*
+ * camera_rays.h
+ *
+ *  Created on: 19/10/2026
+ *      Author: clinton
+ */
+
+#ifndef CAMERA_RAYS_H_
+#define CAMERA_RAYS_H_
+
+#include "types.h"
+#include "ray.h"
+#include "camera.h"
+
+// Table of normalised camera space ray directions for every pixel. It only
+// depends on the resolution and screen depth, so per frame all that's left
+// is rotating it by the camera's axes.
+typedef struct _CameraRays CameraRays;
+
+CameraRays* camera_rays_new();
+void camera_rays_free(CameraRays* rays);
+
+// Rebuilds the table if the resolution or screen depth changed.
+void camera_rays_update(CameraRays* rays, int screen_width, int screen_height, FPType screen_depth);
+
+// Writes the world space directions of count pixels of row y, starting at
+// x, to dx, dy and dz. Matches camera_screen_coord_to_ray().
+void camera_rays_row(const CameraRays* rays, const Camera* camera, int x, int y, int count, FPType* dx, FPType* dy, FPType* dz);
+
+// Same as camera_rays_row() with every ray offset by a sub-pixel jitter.
+// These can't come from the table so are normalised on the fly.
+void camera_rays_row_jittered(const CameraRays* rays, const Camera* camera, int x, int y, int count, FPType jitter_x, FPType jitter_y, FPType* dx, FPType* dy, FPType* dz);
+
+Ray camera_rays_ray(const CameraRays* rays, const Camera* camera, int x, int y);
+Ray camera_rays_ray_jittered(const CameraRays* rays, const Camera* camera, FPType x, FPType y);
+
+#endif /* CAMERA_RAYS_H_ */
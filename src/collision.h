@@ -29,6 +29,7 @@ typedef struct {
 	Vec3 normal;
 	Colour colour;
 	FPType reflectiveness;
+	int primitive; // id of the scene leaf hit, 0 if none
 }CollisionResult;
 
 static __attribute__((unused)) CollisionResult collision_ray_plane(const Ray* ray, const Plane* plane) {
@@ -108,9 +109,10 @@ static __attribute__((unused)) CollisionResult collision_ray_sphere(const Ray* r
 	FPType r = sphere->radius;
 	Vec3 ro_sub_c = vec3_sub(ro, c);
 	FPType ro_sub_c_dot_rd = vec3_dot(&ro_sub_c, rd);
-	FPType rd_dot_rd = vec3_dot(rd, rd);
-	FPType x = -vec3_dot(&ro_sub_c, rd) / rd_dot_rd;
-	if (isnan(x) || isinf(x)) {
+	// With a unit direction rd.rd is 1 and the divisions below drop out.
+	FPType rd_dot_rd = ray->unit ? (FPType)1 : vec3_dot(rd, rd);
+	FPType x = ray->unit ? -ro_sub_c_dot_rd : -ro_sub_c_dot_rd / rd_dot_rd;
+	if (!ray->unit && (isnan(x) || isinf(x))) {
 		return (CollisionResult){
 			.type = None,
 			.time = 0,
@@ -129,7 +131,7 @@ static __attribute__((unused)) CollisionResult collision_ray_sphere(const Ray* r
 			.reflectiveness = 0
 		};
 	}
-	y = sqrt(y) / rd_dot_rd;
+	y = ray->unit ? sqrt(y) : sqrt(y) / rd_dot_rd;
 	FPType t1 = x - y;
 	FPType t2 = x + y;
 	if (t1 > 0) {
@@ -0,0 +1,409 @@
+/*
+ * denoise.c
+ *
+ *  Created on: 19/10/2026
+ *      Author: clinton
+ */
+
+#include <malloc.h>
+#include <math.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#include "aligned.h"
+#include "denoise.h"
+
+// Rows a worker takes at a time.
+#define DENOISE_ROWS 8
+
+// Pixels of a row filtered at a time, few enough that the sums for them
+// stay in the level 1 cache while each neighbour is added.
+#define DENOISE_SPAN 256
+
+// Rows of DENOISE_SPAN sums each worker needs.
+#define DENOISE_SUM_ROWS 7
+
+struct _Denoiser {
+	DenoiseImage image;
+	// Variance of each pixel's brightness, estimated from its neighbours
+	// before the first pass and narrowed as each pass averages it.
+	FPType* variance;
+	// Where each pass writes, swapped with the image's colour after it.
+	FPType* out_red;
+	FPType* out_green;
+	FPType* out_blue;
+	FPType* out_variance;
+	// Sums of the weighted neighbours and weights of the span a worker is
+	// on, DENOISE_SUM_ROWS rows of DENOISE_SPAN for each worker.
+	FPType* sums;
+	int sum_workers;
+	// Shared by the workers during a pass. Step 0 is the variance estimate.
+	int next_row;
+	int step;
+};
+
+Denoiser* denoiser_new() {
+	Denoiser* denoiser = malloc(sizeof(Denoiser));
+	denoiser->image = (DenoiseImage){0, 0, 0, 0, 0, 0, 0, 0, 0};
+	denoiser->variance = 0;
+	denoiser->out_red = 0;
+	denoiser->out_green = 0;
+	denoiser->out_blue = 0;
+	denoiser->out_variance = 0;
+	denoiser->sums = 0;
+	denoiser->sum_workers = 0;
+	return denoiser;
+}
+
+static void denoiser_free_planes(Denoiser* denoiser) {
+	DenoiseImage* image = &denoiser->image;
+	aligned_free(image->red);
+	aligned_free(image->green);
+	aligned_free(image->blue);
+	aligned_free(image->normal_x);
+	aligned_free(image->normal_y);
+	aligned_free(image->normal_z);
+	aligned_free(image->depth);
+	aligned_free(denoiser->variance);
+	aligned_free(denoiser->out_red);
+	aligned_free(denoiser->out_green);
+	aligned_free(denoiser->out_blue);
+	aligned_free(denoiser->out_variance);
+	aligned_free(denoiser->sums);
+	denoiser->sums = 0;
+	denoiser->sum_workers = 0;
+}
+
+void denoiser_free(Denoiser* denoiser) {
+	denoiser_free_planes(denoiser);
+	free(denoiser);
+}
+
+DenoiseImage* denoiser_image(Denoiser* denoiser, int width, int height) {
+	DenoiseImage* image = &denoiser->image;
+	if (image->width == width && image->height == height) { return image; }
+	denoiser_free_planes(denoiser);
+	size_t size = sizeof(FPType) * width * height;
+	*image = (DenoiseImage){
+		width, height,
+		aligned_malloc(size), aligned_malloc(size), aligned_malloc(size),
+		aligned_malloc(size), aligned_malloc(size), aligned_malloc(size),
+		aligned_malloc(size)
+	};
+	denoiser->variance = aligned_malloc(size);
+	denoiser->out_red = aligned_malloc(size);
+	denoiser->out_green = aligned_malloc(size);
+	denoiser->out_blue = aligned_malloc(size);
+	denoiser->out_variance = aligned_malloc(size);
+	return image;
+}
+
+// Estimates the variance of the brightness of each pixel of row y from
+// begin to end from the 3x3 pixels around it. There's no telling noise from
+// detail in one pixel, so this overestimates it where the lighting changes
+// sharply, but that's mostly at edges the normal and depth keep apart
+// anyway.
+static void denoiser_variance_span(Denoiser* denoiser, int y, int begin, int end, FPType* restrict sums) {
+	const DenoiseImage* image = &denoiser->image;
+	const int width = image->width;
+	const int height = image->height;
+	const int count = end - begin;
+	FPType* restrict sum = sums;
+	FPType* restrict sum_squares = sums + DENOISE_SPAN;
+	FPType* restrict samples = sums + 2 * DENOISE_SPAN;
+	for (int x = 0; x < count; ++x) {
+		sum[x] = 0;
+		sum_squares[x] = 0;
+		samples[x] = 0;
+	}
+	for (int ty = y - 1; ty <= y + 1; ++ty) {
+		if (ty < 0 || ty >= height) { continue; }
+		for (int offset = -1; offset <= 1; ++offset) {
+			const int x0 = begin + offset < 0 ? -offset : begin;
+			const int x1 = end + offset > width ? width - offset : end;
+			const int neighbour = ty * width + x0 + offset;
+			const FPType* restrict t_red = image->red + neighbour;
+			const FPType* restrict t_green = image->green + neighbour;
+			const FPType* restrict t_blue = image->blue + neighbour;
+			FPType* restrict s = sum + (x0 - begin);
+			FPType* restrict s2 = sum_squares + (x0 - begin);
+			FPType* restrict n = samples + (x0 - begin);
+			for (int x = 0; x < x1 - x0; ++x) {
+				FPType b = (t_red[x] + t_green[x] + t_blue[x]) * (FPType)(1.0 / 3.0);
+				s[x] += b;
+				s2[x] += b * b;
+				n[x] += (FPType)1;
+			}
+		}
+	}
+	FPType* restrict variance = denoiser->variance + y * width + begin;
+	for (int x = 0; x < count; ++x) {
+		FPType mean = sum[x] / samples[x];
+		FPType v = sum_squares[x] / samples[x] - mean * mean;
+		variance[x] = (v + fabs(v)) * (FPType)0.5;
+	}
+}
+
+#ifdef __SSE2__
+// The loop below four pixels at a time, with SSE2 rather than relying on
+// the compiler to vectorise it. Returns how many pixels it did, leaving
+// the rest to the loop.
+static int denoiser_add_neighbours_vector(const Denoiser* denoiser, int pixel, int neighbour, int count, FPType h,
+		const FPType* restrict inv_variance, const FPType* restrict inv_depth, FPType* restrict sum_red,
+		FPType* restrict sum_green, FPType* restrict sum_blue, FPType* restrict sum_weight, FPType* restrict sum_variance) {
+	const DenoiseImage* image = &denoiser->image;
+	const float* red = image->red + pixel;
+	const float* green = image->green + pixel;
+	const float* blue = image->blue + pixel;
+	const float* normal_x = image->normal_x + pixel;
+	const float* normal_y = image->normal_y + pixel;
+	const float* normal_z = image->normal_z + pixel;
+	const float* depth = image->depth + pixel;
+	const float* t_red = image->red + neighbour;
+	const float* t_green = image->green + neighbour;
+	const float* t_blue = image->blue + neighbour;
+	const float* t_normal_x = image->normal_x + neighbour;
+	const float* t_normal_y = image->normal_y + neighbour;
+	const float* t_normal_z = image->normal_z + neighbour;
+	const float* t_depth = image->depth + neighbour;
+	const float* t_variance = denoiser->variance + neighbour;
+	const __m128 third = _mm_set1_ps((float)(1.0 / 3.0));
+	const __m128 one = _mm_set1_ps(1.0f);
+	const __m128 eighth = _mm_set1_ps(0.125f);
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 sign = _mm_set1_ps(-0.0f);
+	const __m128 inv_sigma_normal = _mm_set1_ps((float)(1.0 / DENOISE_SIGMA_NORMAL));
+	const __m128 weight = _mm_set1_ps(h);
+	int x = 0;
+	// Loads are unaligned, as neither the span nor the neighbour's offset
+	// need be a multiple of 4.
+	for (; x + 4 <= count; x += 4) {
+		const __m128 tr = _mm_loadu_ps(t_red + x);
+		const __m128 tg = _mm_loadu_ps(t_green + x);
+		const __m128 tb = _mm_loadu_ps(t_blue + x);
+		__m128 brightness = _mm_sub_ps(tr, _mm_loadu_ps(red + x));
+		brightness = _mm_sub_ps(_mm_add_ps(brightness, tg), _mm_loadu_ps(green + x));
+		brightness = _mm_sub_ps(_mm_add_ps(brightness, tb), _mm_loadu_ps(blue + x));
+		brightness = _mm_mul_ps(brightness, third);
+		__m128 e = _mm_mul_ps(_mm_mul_ps(brightness, brightness), _mm_loadu_ps(inv_variance + x));
+		__m128 c = _mm_mul_ps(_mm_loadu_ps(normal_x + x), _mm_loadu_ps(t_normal_x + x));
+		c = _mm_add_ps(c, _mm_mul_ps(_mm_loadu_ps(normal_y + x), _mm_loadu_ps(t_normal_y + x)));
+		c = _mm_add_ps(c, _mm_mul_ps(_mm_loadu_ps(normal_z + x), _mm_loadu_ps(t_normal_z + x)));
+		e = _mm_add_ps(e, _mm_mul_ps(_mm_sub_ps(one, c), inv_sigma_normal));
+		const __m128 d = _mm_andnot_ps(sign, _mm_sub_ps(_mm_loadu_ps(t_depth + x), _mm_loadu_ps(depth + x)));
+		e = _mm_add_ps(e, _mm_mul_ps(d, _mm_loadu_ps(inv_depth + x)));
+		__m128 a = _mm_max_ps(_mm_sub_ps(one, _mm_mul_ps(e, eighth)), zero);
+		a = _mm_mul_ps(a, a);
+		a = _mm_mul_ps(a, a);
+		a = _mm_mul_ps(a, a);
+		const __m128 w = _mm_mul_ps(weight, a);
+		_mm_storeu_ps(sum_red + x, _mm_add_ps(_mm_loadu_ps(sum_red + x), _mm_mul_ps(w, tr)));
+		_mm_storeu_ps(sum_green + x, _mm_add_ps(_mm_loadu_ps(sum_green + x), _mm_mul_ps(w, tg)));
+		_mm_storeu_ps(sum_blue + x, _mm_add_ps(_mm_loadu_ps(sum_blue + x), _mm_mul_ps(w, tb)));
+		_mm_storeu_ps(sum_weight + x, _mm_add_ps(_mm_loadu_ps(sum_weight + x), w));
+		const __m128 v = _mm_mul_ps(_mm_mul_ps(w, w), _mm_loadu_ps(t_variance + x));
+		_mm_storeu_ps(sum_variance + x, _mm_add_ps(_mm_loadu_ps(sum_variance + x), v));
+	}
+	return x;
+}
+#endif
+
+// Adds count neighbours, from the one at index neighbour on, to the sums of
+// the pixels from the one at index pixel on. The sums are passed as
+// restrict parameters, which is what lets the compiler vectorise the loop
+// without checking them against every plane it reads, where it's left to.
+static void denoiser_add_neighbours(const Denoiser* denoiser, int pixel, int neighbour, int count, FPType h,
+		const FPType* restrict inv_variance, const FPType* restrict inv_depth, FPType* restrict sum_red,
+		FPType* restrict sum_green, FPType* restrict sum_blue, FPType* restrict sum_weight, FPType* restrict sum_variance) {
+	const DenoiseImage* image = &denoiser->image;
+	const FPType inv_sigma_normal = (FPType)1 / (FPType)DENOISE_SIGMA_NORMAL;
+	const FPType* red = image->red + pixel;
+	const FPType* green = image->green + pixel;
+	const FPType* blue = image->blue + pixel;
+	const FPType* normal_x = image->normal_x + pixel;
+	const FPType* normal_y = image->normal_y + pixel;
+	const FPType* normal_z = image->normal_z + pixel;
+	const FPType* depth = image->depth + pixel;
+	const FPType* t_red = image->red + neighbour;
+	const FPType* t_green = image->green + neighbour;
+	const FPType* t_blue = image->blue + neighbour;
+	const FPType* t_normal_x = image->normal_x + neighbour;
+	const FPType* t_normal_y = image->normal_y + neighbour;
+	const FPType* t_normal_z = image->normal_z + neighbour;
+	const FPType* t_depth = image->depth + neighbour;
+	const FPType* t_variance = denoiser->variance + neighbour;
+	int x = 0;
+#ifdef __SSE2__
+	x = denoiser_add_neighbours_vector(denoiser, pixel, neighbour, count, h, inv_variance, inv_depth,
+		sum_red, sum_green, sum_blue, sum_weight, sum_variance);
+#endif
+	for (; x < count; ++x) {
+		FPType brightness = (t_red[x] - red[x] + t_green[x] - green[x] + t_blue[x] - blue[x]) * (FPType)(1.0 / 3.0);
+		FPType e = brightness * brightness * inv_variance[x];
+		FPType c = normal_x[x] * t_normal_x[x] + normal_y[x] * t_normal_y[x] + normal_z[x] * t_normal_z[x];
+		e += ((FPType)1 - c) * inv_sigma_normal;
+		e += fabs(t_depth[x] - depth[x]) * inv_depth[x];
+		// (1 - e/8)^8 falls off like exp(-e) until it reaches 0 at e = 8,
+		// and is far cheaper. The max with 0 is done without a comparison,
+		// which would stop the loop being vectorised.
+		FPType a = (FPType)1 - e * (FPType)0.125;
+		a = (a + fabs(a)) * (FPType)0.5;
+		a *= a;
+		a *= a;
+		a *= a;
+		FPType w = h * a;
+		sum_red[x] += w * t_red[x];
+		sum_green[x] += w * t_green[x];
+		sum_blue[x] += w * t_blue[x];
+		sum_weight[x] += w;
+		sum_variance[x] += w * w * t_variance[x];
+	}
+}
+
+// Filters the pixels of row y from begin to end for the pass in progress.
+// Rather than gathering the nine neighbours of one pixel at a time, each
+// neighbour is added to the whole span in turn, which keeps every load in
+// the inner loop contiguous so the compiler can vectorise it.
+static void denoiser_span(Denoiser* denoiser, int y, int begin, int end, FPType* restrict sums) {
+	const DenoiseImage* image = &denoiser->image;
+	const int width = image->width;
+	const int height = image->height;
+	const int step = denoiser->step;
+	const int count = end - begin;
+	// Linear B-spline, 1/4 1/2 1/4 each way.
+	const FPType kernel[3] = {0.25, 0.5, 0.25};
+
+	FPType* restrict sum_red = sums;
+	FPType* restrict sum_green = sums + DENOISE_SPAN;
+	FPType* restrict sum_blue = sums + 2 * DENOISE_SPAN;
+	FPType* restrict sum_weight = sums + 3 * DENOISE_SPAN;
+	FPType* restrict sum_variance = sums + 4 * DENOISE_SPAN;
+	FPType* restrict inv_variance = sums + 5 * DENOISE_SPAN;
+	FPType* restrict inv_depth = sums + 6 * DENOISE_SPAN;
+	const int pixel = y * width + begin;
+	const FPType* restrict red = image->red + pixel;
+	const FPType* restrict green = image->green + pixel;
+	const FPType* restrict blue = image->blue + pixel;
+	const FPType* restrict depth = image->depth + pixel;
+	const FPType* restrict variance = denoiser->variance + pixel;
+	// Squared differences in brightness are compared to the variance, rather
+	// than differences to the deviation, which would need a square root.
+	const FPType sigma_colour = (FPType)(DENOISE_SIGMA_COLOUR * DENOISE_SIGMA_COLOUR);
+	const FPType sigma_depth = (FPType)DENOISE_SIGMA_DEPTH * (FPType)step;
+	const FPType centre = kernel[1] * kernel[1];
+	int x = 0;
+#ifdef __SSE2__
+	{
+		const __m128 c = _mm_set1_ps(centre);
+		const __m128 cc = _mm_set1_ps(centre * centre);
+		const __m128 one = _mm_set1_ps(1.0f);
+		const __m128 s_colour = _mm_set1_ps(sigma_colour);
+		const __m128 s_depth = _mm_set1_ps(sigma_depth);
+		const __m128 epsilon = _mm_set1_ps(1e-6f);
+		for (; x + 4 <= count; x += 4) {
+			const __m128 v = _mm_loadu_ps(variance + x);
+			_mm_storeu_ps(sum_red + x, _mm_mul_ps(c, _mm_loadu_ps(red + x)));
+			_mm_storeu_ps(sum_green + x, _mm_mul_ps(c, _mm_loadu_ps(green + x)));
+			_mm_storeu_ps(sum_blue + x, _mm_mul_ps(c, _mm_loadu_ps(blue + x)));
+			_mm_storeu_ps(sum_weight + x, c);
+			_mm_storeu_ps(sum_variance + x, _mm_mul_ps(cc, v));
+			_mm_storeu_ps(inv_variance + x, _mm_div_ps(one, _mm_add_ps(_mm_mul_ps(s_colour, v), epsilon)));
+			_mm_storeu_ps(inv_depth + x, _mm_div_ps(one, _mm_mul_ps(s_depth, _mm_loadu_ps(depth + x))));
+		}
+	}
+#endif
+	for (; x < count; ++x) {
+		sum_red[x] = centre * red[x];
+		sum_green[x] = centre * green[x];
+		sum_blue[x] = centre * blue[x];
+		sum_weight[x] = centre;
+		sum_variance[x] = centre * centre * variance[x];
+		inv_variance[x] = (FPType)1 / (sigma_colour * variance[x] + (FPType)1e-6);
+		inv_depth[x] = (FPType)1 / (sigma_depth * depth[x]);
+	}
+
+	for (int j = 0; j < 3; ++j) {
+		const int ty = y + (j - 1) * step;
+		// Neighbours off the image are left out.
+		if (ty < 0 || ty >= height) { continue; }
+		for (int i = 0; i < 3; ++i) {
+			if (i == 1 && j == 1) { continue; }
+			const int offset = (i - 1) * step;
+			const int x0 = begin + offset < 0 ? -offset : begin;
+			const int x1 = end + offset > width ? width - offset : end;
+			if (x1 <= x0) { continue; }
+			const int skip = x0 - begin;
+			denoiser_add_neighbours(denoiser, pixel + skip, ty * width + x0 + offset, x1 - x0, kernel[i] * kernel[j],
+				inv_variance + skip, inv_depth + skip, sum_red + skip, sum_green + skip, sum_blue + skip,
+				sum_weight + skip, sum_variance + skip);
+		}
+	}
+
+	FPType* restrict out_red = denoiser->out_red + pixel;
+	FPType* restrict out_green = denoiser->out_green + pixel;
+	FPType* restrict out_blue = denoiser->out_blue + pixel;
+	FPType* restrict out_variance = denoiser->out_variance + pixel;
+	x = 0;
+#ifdef __SSE2__
+	for (; x + 4 <= count; x += 4) {
+		const __m128 inv = _mm_div_ps(_mm_set1_ps(1.0f), _mm_loadu_ps(sum_weight + x));
+		_mm_storeu_ps(out_red + x, _mm_mul_ps(_mm_loadu_ps(sum_red + x), inv));
+		_mm_storeu_ps(out_green + x, _mm_mul_ps(_mm_loadu_ps(sum_green + x), inv));
+		_mm_storeu_ps(out_blue + x, _mm_mul_ps(_mm_loadu_ps(sum_blue + x), inv));
+		_mm_storeu_ps(out_variance + x, _mm_mul_ps(_mm_loadu_ps(sum_variance + x), _mm_mul_ps(inv, inv)));
+	}
+#endif
+	for (; x < count; ++x) {
+		FPType inv = (FPType)1 / sum_weight[x];
+		out_red[x] = sum_red[x] * inv;
+		out_green[x] = sum_green[x] * inv;
+		out_blue[x] = sum_blue[x] * inv;
+		out_variance[x] = sum_variance[x] * inv * inv;
+	}
+}
+
+static void denoiser_worker(void* data, int worker) {
+	Denoiser* denoiser = data;
+	FPType* sums = denoiser->sums + worker * DENOISE_SUM_ROWS * DENOISE_SPAN;
+	const int width = denoiser->image.width;
+	const int height = denoiser->image.height;
+	for (;;) {
+		int y0 = __sync_fetch_and_add(&denoiser->next_row, DENOISE_ROWS);
+		if (y0 >= height) { break; }
+		int y1 = y0 + DENOISE_ROWS < height ? y0 + DENOISE_ROWS : height;
+		for (int y = y0; y < y1; ++y) {
+			for (int begin = 0; begin < width; begin += DENOISE_SPAN) {
+				int end = begin + DENOISE_SPAN < width ? begin + DENOISE_SPAN : width;
+				if (denoiser->step == 0) {
+					denoiser_variance_span(denoiser, y, begin, end, sums);
+				} else {
+					denoiser_span(denoiser, y, begin, end, sums);
+				}
+			}
+		}
+	}
+}
+
+void denoiser_run(Denoiser* denoiser, Workers* workers) {
+	DenoiseImage* image = &denoiser->image;
+	if (image->width == 0 || image->height == 0) { return; }
+	const int worker_count = workers_count(workers);
+	if (denoiser->sum_workers != worker_count) {
+		aligned_free(denoiser->sums);
+		denoiser->sums = aligned_malloc(sizeof(FPType) * DENOISE_SUM_ROWS * DENOISE_SPAN * worker_count);
+		denoiser->sum_workers = worker_count;
+	}
+	denoiser->step = 0;
+	denoiser->next_row = 0;
+	workers_run(workers, denoiser_worker, denoiser);
+	for (int pass = 0; pass < DENOISE_PASSES; ++pass) {
+		denoiser->step = 1 << pass;
+		denoiser->next_row = 0;
+		workers_run(workers, denoiser_worker, denoiser);
+		FPType* tmp;
+		tmp = image->red; image->red = denoiser->out_red; denoiser->out_red = tmp;
+		tmp = image->green; image->green = denoiser->out_green; denoiser->out_green = tmp;
+		tmp = image->blue; image->blue = denoiser->out_blue; denoiser->out_blue = tmp;
+		tmp = denoiser->variance; denoiser->variance = denoiser->out_variance; denoiser->out_variance = tmp;
+	}
+}
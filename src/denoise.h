@@ -0,0 +1,64 @@
+/*
+ * denoise.h
+ *
+ *  Created on: 19/10/2026
+ *      Author: clinton
+ */
+
+#ifndef DENOISE_H_
+#define DENOISE_H_
+
+#include "types.h"
+#include "workers.h"
+
+// Each pass of the filter spreads twice as far as the last, so it reaches
+// 2^DENOISE_PASSES - 1 pixels each way in all.
+#define DENOISE_PASSES 5
+
+// How fast a neighbour's weight falls off with how different it is from the
+// pixel being filtered: in brightness, in standard deviations of the
+// pixel's noise; in 1 minus the cosine between their normals; and in depth,
+// relative to the pixel's, per pixel apart. Lower keeps edges sharper and
+// smooths less.
+#define DENOISE_SIGMA_COLOUR 4.0
+#define DENOISE_SIGMA_NORMAL 0.1
+#define DENOISE_SIGMA_DEPTH 0.02
+
+// Edge-avoiding a-trous wavelet filter for noisy renders. Each pass
+// averages every pixel with its neighbours on a 3x3 grid spaced 2^pass
+// apart, weighted down by how different their colour, normal and depth
+// are, so it smooths noise across surfaces without blurring across their
+// edges. Colour differences are judged against how noisy the pixel is, so
+// it smooths hard where there are few samples and hardly at all once the
+// image has converged. Texture should be divided out of the colour first
+// and multiplied back in after, so the filter only sees lighting.
+typedef struct _Denoiser Denoiser;
+
+// An image to filter, one plane per channel in row major order, each
+// aligned for vector loads.
+typedef struct {
+	int width;
+	int height;
+	// Noisy in, filtered out.
+	FPType* red;
+	FPType* green;
+	FPType* blue;
+	// Guides, of the surface each pixel sees. Misses should have a depth
+	// far beyond anything hit.
+	FPType* normal_x;
+	FPType* normal_y;
+	FPType* normal_z;
+	FPType* depth;
+}DenoiseImage;
+
+Denoiser* denoiser_new();
+void denoiser_free(Denoiser* denoiser);
+
+// Returns the image to fill in, which keeps what it had unless the size
+// changed.
+DenoiseImage* denoiser_image(Denoiser* denoiser, int width, int height);
+
+// Filters the image in place, sharing the rows out between the workers.
+void denoiser_run(Denoiser* denoiser, Workers* workers);
+
+#endif /* DENOISE_H_ */
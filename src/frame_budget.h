@@ -0,0 +1,82 @@
+/*
+ * frame_budget.h
+ *
+ *  Created on: 19/10/2026
+ *      Author: clinton
+ */
+
+#ifndef FRAME_BUDGET_H_
+#define FRAME_BUDGET_H_
+
+#include <math.h>
+#include "types.h"
+
+// The scale is always a multiple of 1/FRAME_BUDGET_SCALE_STEPS, so a 640x480
+// frame scales to whole pixel sizes and small changes in frame time don't
+// resize anything.
+#define FRAME_BUDGET_SCALE_STEPS 16
+
+// Weight of the newest frame time in the running average.
+#define FRAME_BUDGET_SMOOTHING 0.25
+
+// The average may be this far either side of the target before the scale
+// changes.
+#define FRAME_BUDGET_TOLERANCE 0.2
+
+// Frames ignored after a change while the new scale's cost settles.
+#define FRAME_BUDGET_SETTLE_FRAMES 4
+
+// Picks the fraction of full resolution (along each axis) to render at so
+// the average frame time stays near a target.
+typedef struct {
+	FPType target_time; // seconds
+	FPType min_scale;
+	FPType scale;
+	// Running average of frame time at the current scale, or negative if
+	// nothing has been measured yet.
+	FPType average_time;
+	int settle;
+}FrameBudget;
+
+static inline FrameBudget frame_budget_init(FPType target_time, FPType min_scale) {
+	return (FrameBudget){
+		.target_time = target_time,
+		.min_scale = min_scale,
+		.scale = (FPType)1,
+		.average_time = (FPType)-1,
+		.settle = 0
+	};
+}
+
+static inline FPType frame_budget_quantize(FPType scale) {
+	return floor(scale * FRAME_BUDGET_SCALE_STEPS) / (FPType)FRAME_BUDGET_SCALE_STEPS;
+}
+
+// Feeds in the time one frame took at the current scale. Returns non-zero if
+// the scale changed.
+static inline int frame_budget_update(FrameBudget* budget, FPType frame_time) {
+	if (budget->settle > 0) {
+		--budget->settle;
+		return 0;
+	}
+	if (budget->average_time < (FPType)0) {
+		budget->average_time = frame_time;
+	} else {
+		budget->average_time += (FPType)FRAME_BUDGET_SMOOTHING * (frame_time - budget->average_time);
+	}
+	FPType ratio = budget->target_time / fmax(budget->average_time, (FPType)1e-4);
+	if (fabs(ratio - (FPType)1) <= (FPType)FRAME_BUDGET_TOLERANCE) { return 0; }
+	// Frame time goes with the pixel count, i.e. the square of the scale.
+	// Rounding the ideal scale down means a change never lands over the
+	// target, and the next step up would, so it doesn't flip back and forth.
+	FPType scale = frame_budget_quantize(budget->scale * sqrt(ratio));
+	if (scale < budget->min_scale) { scale = budget->min_scale; }
+	if (scale > (FPType)1) { scale = (FPType)1; }
+	if (scale == budget->scale) { return 0; }
+	budget->scale = scale;
+	budget->average_time = (FPType)-1;
+	budget->settle = FRAME_BUDGET_SETTLE_FRAMES;
+	return 1;
+}
+
+#endif /* FRAME_BUDGET_H_ */
@@ -0,0 +1,36 @@
+/*
+ * frame_pacer.h
+ *
+ *  Created on: 19/10/2026
+ *      Author: clinton
+ */
+
+#ifndef FRAME_PACER_H_
+#define FRAME_PACER_H_
+
+#include <SDL.h>
+#include "types.h"
+
+// Starts a frame once per period, sleeping for whatever's left of the period
+// once the last frame is done rather than for a fixed time.
+typedef struct {
+	Uint32 period; // milliseconds
+	Uint32 next; // ticks the next frame is due
+}FramePacer;
+
+static inline FramePacer frame_pacer_init(FPType period) {
+	return (FramePacer){(Uint32)(period * (FPType)1000 + (FPType)0.5), 0};
+}
+
+// Sleeps until the next frame is due. A frame that overran starts straight
+// away, and the ones after it are paced from there rather than catching up.
+static inline void frame_pacer_wait(FramePacer* pacer) {
+	Uint32 now = SDL_GetTicks();
+	if ((Sint32)(pacer->next - now) > 0) {
+		SDL_Delay(pacer->next - now);
+		now = pacer->next;
+	}
+	pacer->next = now + pacer->period;
+}
+
+#endif /* FRAME_PACER_H_ */
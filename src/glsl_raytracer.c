@@ -5,6 +5,7 @@
  *      Author: Clinton
  */
 
+#include <memory.h>
 #include <SDL.h>
 #include <GL/glew.h>
 //#include <gl/gl.h>
@@ -16,15 +17,37 @@
 #include "collision.h"
 #include "scene.h"
 #include "camera.h"
+#include "frame_pacer.h"
+#include "latency_histogram.h"
 
 static const int SCREEN_WIDTH = 640;
 static const int SCREEN_HEIGHT = 480;
 static const int SCREEN_BPP = 24;
 
+// Frames are started at most this often.
+static const FPType FRAME_PERIOD = 1.0 / 60.0;
+
+// Degrees per second the camera turns and units per second it moves while
+// a key is held. A stall longer than MAX_CAMERA_STEP seconds only moves it
+// that far.
+static const FPType TURN_SPEED = 120;
+static const FPType MOVE_SPEED = 200;
+static const FPType MAX_CAMERA_STEP = 0.1;
+
 static SDL_Surface* screen = 0;
 static int done = 0;
+// Set when the camera or window contents need the frame drawn again. The
+// scene and resolution are fixed once the shader is built.
+static int dirty = 1;
+static int frames_rendered = 0;
+static int frames_skipped = 0;
 static GLuint programId,vertexShaderId,fragmentShaderId;
 static Camera camera;
+// Ticks when the camera was last moved.
+static Uint32 camera_ticks = 0;
+// Ticks when the input the frame being drawn reflects was taken.
+static Uint32 input_ticks = 0;
+static LatencyHistogram latency;
 
 static int left_down = 0;
 static int right_down = 0;
@@ -238,6 +261,7 @@ static void render() {
 	glEnd();
 
 	SDL_GL_SwapBuffers();
+	latency_histogram_add(&latency, SDL_GetTicks() - input_ticks);
 }
 
 static void process_events() {
@@ -247,6 +271,9 @@ static void process_events() {
 		case SDL_QUIT:
 			done = 1;
 			break;
+		case SDL_VIDEOEXPOSE:
+			dirty = 1;
+			break;
 		case SDL_KEYDOWN:
 			switch (event.key.keysym.sym) {
 			case SDLK_LEFT:
@@ -313,40 +340,67 @@ static void process_events() {
 	}
 }
 
+// Moves the camera as far as the keys held move it in the time since it was
+// last moved, so its speed doesn't depend on the frame rate.
 static void move_camera() {
+	Camera last_camera = camera;
+	Uint32 now = SDL_GetTicks();
+	FPType seconds = (now - camera_ticks) / (FPType)1000;
+	if (seconds > MAX_CAMERA_STEP) { seconds = MAX_CAMERA_STEP; }
+	camera_ticks = now;
+	const FPType turn = TURN_SPEED * seconds;
+	const FPType move = MOVE_SPEED * seconds;
 	if (left_down) {
-		camera = camera_turn_left(&camera, 3);
+		camera = camera_turn_left(&camera, turn);
 	}
 	if (right_down) {
-		camera = camera_turn_right(&camera, 3);
+		camera = camera_turn_right(&camera, turn);
 	}
 	if (down_down) {
-		camera = camera_turn_down(&camera, 3);
+		camera = camera_turn_down(&camera, turn);
 	}
 	if (up_down) {
-		camera = camera_turn_up(&camera, 3);
+		camera = camera_turn_up(&camera, turn);
 	}
 	if (w_down) {
-		camera = camera_move_forward(&camera, 5);
+		camera = camera_move_forward(&camera, move);
 	}
 	if (s_down) {
-		camera = camera_move_back(&camera, 5);
+		camera = camera_move_back(&camera, move);
 	}
 	if (a_down) {
-		camera = camera_move_left(&camera, 5);
+		camera = camera_move_left(&camera, move);
 	}
 	if (d_down) {
-		camera = camera_move_right(&camera, 5);
+		camera = camera_move_right(&camera, move);
+	}
+	if (memcmp(&camera, &last_camera, sizeof(Camera)) != 0) {
+		dirty = 1;
 	}
 }
 
 static void run() {
+	FramePacer pacer = frame_pacer_init(FRAME_PERIOD);
+	latency = latency_histogram_init();
+	camera_ticks = SDL_GetTicks();
 	while (!done) {
-		render();
+		// Sleeps off what's left of the frame time before taking input
+		// rather than after, so each frame starts with the latest input.
+		frame_pacer_wait(&pacer);
 		process_events();
+		input_ticks = SDL_GetTicks();
 		move_camera();
-		SDL_Delay(10);
+		// Without a swap the window keeps showing the last frame.
+		if (dirty) {
+			render();
+			dirty = 0;
+			++frames_rendered;
+		} else {
+			++frames_skipped;
+		}
 	}
+	printf("%d frames rendered, %d skipped\n", frames_rendered, frames_skipped);
+	latency_histogram_print(&latency);
 }
 
 static void final() {
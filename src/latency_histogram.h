@@ -0,0 +1,72 @@
+/*
+ * latency_histogram.h
+ *
+ *  Created on: 19/10/2026
+ *      Author: clinton
+ */
+
+#ifndef LATENCY_HISTOGRAM_H_
+#define LATENCY_HISTOGRAM_H_
+
+#include <stdio.h>
+#include <math.h>
+#include <SDL.h>
+#include "types.h"
+
+// Latencies are counted in buckets this many milliseconds wide, the last one
+// holding everything beyond.
+#define LATENCY_HISTOGRAM_BUCKET_MS 4
+#define LATENCY_HISTOGRAM_BUCKETS 32
+
+// Counts how long frames took to reach the screen, in milliseconds.
+typedef struct {
+	int counts[LATENCY_HISTOGRAM_BUCKETS];
+	int total;
+	Uint32 max;
+}LatencyHistogram;
+
+static inline LatencyHistogram latency_histogram_init() {
+	LatencyHistogram histogram;
+	for (int i = 0; i < LATENCY_HISTOGRAM_BUCKETS; ++i) {
+		histogram.counts[i] = 0;
+	}
+	histogram.total = 0;
+	histogram.max = 0;
+	return histogram;
+}
+
+static inline void latency_histogram_add(LatencyHistogram* histogram, Uint32 latency) {
+	int bucket = latency / LATENCY_HISTOGRAM_BUCKET_MS;
+	if (bucket >= LATENCY_HISTOGRAM_BUCKETS) { bucket = LATENCY_HISTOGRAM_BUCKETS - 1; }
+	++histogram->counts[bucket];
+	++histogram->total;
+	if (latency > histogram->max) { histogram->max = latency; }
+}
+
+// Upper bound in milliseconds of the bucket the given fraction of latencies
+// fall at or under.
+static inline Uint32 latency_histogram_percentile(const LatencyHistogram* histogram, FPType fraction) {
+	int wanted = (int)ceil(fraction * (FPType)histogram->total);
+	int count = 0;
+	for (int i = 0; i < LATENCY_HISTOGRAM_BUCKETS - 1; ++i) {
+		count += histogram->counts[i];
+		if (count >= wanted) { return (i + 1) * LATENCY_HISTOGRAM_BUCKET_MS; }
+	}
+	return histogram->max;
+}
+
+static inline void latency_histogram_print(const LatencyHistogram* histogram) {
+	if (histogram->total == 0) { return; }
+	printf("input to present latency: %u ms median, %u ms 95th percentile, %u ms max\n",
+		latency_histogram_percentile(histogram, 0.5), latency_histogram_percentile(histogram, 0.95), histogram->max);
+	for (int i = 0; i < LATENCY_HISTOGRAM_BUCKETS; ++i) {
+		if (histogram->counts[i] == 0) { continue; }
+		if (i == LATENCY_HISTOGRAM_BUCKETS - 1) {
+			printf("  %3d+    ms: %d\n", i * LATENCY_HISTOGRAM_BUCKET_MS, histogram->counts[i]);
+		} else {
+			printf("  %3d-%-3d ms: %d\n", i * LATENCY_HISTOGRAM_BUCKET_MS, (i + 1) * LATENCY_HISTOGRAM_BUCKET_MS, histogram->counts[i]);
+		}
+	}
+}
+
+#endif /* LATENCY_HISTOGRAM_H_ */
@@ -0,0 +1,171 @@
+/*
+ * light.h
+ *
+ *  Created on: 19/10/2026
+ *      Author: clinton
+ */
+
+#ifndef LIGHT_H_
+#define LIGHT_H_
+
+#include <math.h>
+#include "types.h"
+#include "vec3.h"
+#include "colour.h"
+#include "util.h"
+
+typedef enum {
+	LightType_Point,
+	LightType_Spot,
+	// Area lights, shining from one side of a rectangle or a disk. They
+	// cast soft shadows, and are sampled at points across them.
+	LightType_Rect,
+	LightType_Disk
+}LightType;
+
+// A light at a point, falling off with the square of the distance. colour is
+// the irradiance it gives a surface facing it one unit away. For an area
+// light, that's from all of it, seen face on, as if it were all at its
+// centre.
+typedef struct {
+	LightType type;
+	Vec3 position;
+	Colour colour;
+	// Spot lights, full brightness within cos_inner of direction, fading to
+	// nothing at cos_outer. Area lights, the way they face.
+	Vec3 direction;
+	FPType cos_inner;
+	FPType cos_outer;
+	// Area lights only. Half the sides of a rectangle, or the radius of a
+	// disk along two axes across direction.
+	Vec3 axis_u;
+	Vec3 axis_v;
+}Light;
+
+static inline Light light_point(const Vec3* position, const Colour* colour) {
+	return (Light){
+		.type = LightType_Point,
+		.position = *position,
+		.colour = *colour,
+		.direction = (Vec3){0,0,0},
+		.cos_inner = -1,
+		.cos_outer = -1,
+		.axis_u = (Vec3){0,0,0},
+		.axis_v = (Vec3){0,0,0}
+	};
+}
+
+// Angles are in degrees from direction to the edge of the cone.
+static inline Light light_spot(const Vec3* position, const Colour* colour, const Vec3* direction, FPType inner_angle, FPType outer_angle) {
+	return (Light){
+		.type = LightType_Spot,
+		.position = *position,
+		.colour = *colour,
+		.direction = vec3_normalize(direction),
+		.cos_inner = cos_deg(inner_angle),
+		.cos_outer = cos_deg(outer_angle),
+		.axis_u = (Vec3){0,0,0},
+		.axis_v = (Vec3){0,0,0}
+	};
+}
+
+static inline Light light_area(LightType type, const Vec3* position, const Colour* colour, const Vec3* direction, FPType size_u, FPType size_v) {
+	Vec3 d = vec3_normalize(direction);
+	// Any two axes across direction will do.
+	Vec3 axis = fabs(d.x) < (FPType)0.5 ? (Vec3){1,0,0} : (Vec3){0,1,0};
+	Vec3 u = vec3_cross(&d, &axis);
+	u = vec3_normalize(&u);
+	Vec3 v = vec3_cross(&d, &u);
+	return (Light){
+		.type = type,
+		.position = *position,
+		.colour = *colour,
+		.direction = d,
+		.cos_inner = -1,
+		.cos_outer = -1,
+		.axis_u = vec3_scale(&u, size_u * (FPType)0.5),
+		.axis_v = vec3_scale(&v, size_v * (FPType)0.5)
+	};
+}
+
+// Centred on position, width by height, facing direction.
+static inline Light light_rect(const Vec3* position, const Colour* colour, const Vec3* direction, FPType width, FPType height) {
+	return light_area(LightType_Rect, position, colour, direction, width, height);
+}
+
+static inline Light light_disk(const Vec3* position, const Colour* colour, const Vec3* direction, FPType radius) {
+	return light_area(LightType_Disk, position, colour, direction, radius * (FPType)2, radius * (FPType)2);
+}
+
+static inline int light_is_area(const Light* light) {
+	return light->type == LightType_Rect || light->type == LightType_Disk;
+}
+
+// A point on the light, for u and v uniform in [0, 1). Points spread evenly
+// over [0, 1)^2 spread evenly over the light.
+static inline Vec3 light_sample_position(const Light* light, FPType u, FPType v) {
+	FPType a, b;
+	if (light->type == LightType_Rect) {
+		a = (FPType)2 * u - (FPType)1;
+		b = (FPType)2 * v - (FPType)1;
+	} else if (light->type == LightType_Disk) {
+		FPType r = sqrt(u);
+		FPType phi = (FPType)(2 * M_PI) * v;
+		a = r * cos(phi);
+		b = r * sin(phi);
+	} else {
+		return light->position;
+	}
+	Vec3 du = vec3_scale(&light->axis_u, a);
+	Vec3 dv = vec3_scale(&light->axis_v, b);
+	Vec3 p = vec3_add(&light->position, &du);
+	return vec3_add(&p, &dv);
+}
+
+// Brightness of the light in every direction it shines, to weigh it against
+// others by.
+static inline FPType light_power(const Light* light) {
+	FPType power = (light->colour.red + light->colour.green + light->colour.blue) / (FPType)3;
+	if (light->type == LightType_Spot) {
+		// Fraction of the sphere the cone covers.
+		power *= ((FPType)1 - light->cos_outer) / (FPType)2;
+	} else if (light_is_area(light)) {
+		// Falling off with the cosine over one side gives a quarter of
+		// what shining evenly all round would.
+		power *= (FPType)0.25;
+	}
+	return power;
+}
+
+// Irradiance the light gives a surface at point facing normal, ignoring
+// anything in the way, if it were all at from, a point on it. The direction
+// to from, normalised, and its distance are written to to_light and
+// distance.
+static inline Colour light_illuminate_from(const Light* light, const Vec3* from, const Vec3* point, const Vec3* normal, Vec3* to_light, FPType* distance) {
+	Vec3 v = vec3_sub(from, point);
+	FPType distance_squared = vec3_length_squared(&v);
+	*distance = sqrt(distance_squared);
+	*to_light = vec3_scale(&v, (FPType)1 / *distance);
+	FPType a = vec3_dot(to_light, normal) / distance_squared;
+	if (!(a > (FPType)0)) { return (Colour){0,0,0}; }
+	if (light->type == LightType_Spot) {
+		FPType c = -vec3_dot(to_light, &light->direction);
+		if (c <= light->cos_outer) { return (Colour){0,0,0}; }
+		if (c < light->cos_inner) {
+			a *= (c - light->cos_outer) / (light->cos_inner - light->cos_outer);
+		}
+	} else if (light_is_area(light)) {
+		FPType c = -vec3_dot(to_light, &light->direction);
+		if (!(c > (FPType)0)) { return (Colour){0,0,0}; }
+		a *= c;
+	}
+	return (Colour){a * light->colour.red, a * light->colour.green, a * light->colour.blue};
+}
+
+// The same from the light's position, which for an area light is its
+// centre.
+static inline Colour light_illuminate(const Light* light, const Vec3* point, const Vec3* normal, Vec3* to_light, FPType* distance) {
+	return light_illuminate_from(light, &light->position, point, normal, to_light, distance);
+}
+
+#endif /* LIGHT_H_ */
@@ -0,0 +1,242 @@
+/*
+ * light_grid.c
+ *
+ *  Created on: 19/10/2026
+ *      Author: clinton
+ */
+
+#include <malloc.h>
+#include <memory.h>
+#include <math.h>
+#include "light_grid.h"
+
+typedef struct {
+	const Scene* scene;
+	Bounds bounds;
+	// Covered on the plane across the light.
+	FPType min_u, max_u, min_v, max_v;
+}LightGridOperand;
+
+struct _LightGrid {
+	const Scene* scene;
+	int scene_id; // of what it was built for, as the scene may be freed
+	Vec3 light_dir;
+	// Axes of the plane across the light.
+	Vec3 u, v;
+	// Bounded operands first, then those whose projection is unbounded,
+	// which every point has to be checked against.
+	LightGridOperand* operands;
+	int operand_count;
+	int bounded_count;
+	FPType min_u, min_v;
+	FPType cell_width, cell_height;
+	int columns, rows;
+	// The operands of cell i are cell_operands[cell_start[i]] up to
+	// cell_operands[cell_start[i + 1]].
+	int* cell_start;
+	int* cell_operands;
+};
+
+LightGrid* light_grid_new() {
+	LightGrid* grid = malloc(sizeof(LightGrid));
+	grid->scene = 0;
+	grid->scene_id = 0;
+	grid->light_dir = (Vec3){0,0,0};
+	grid->operands = 0;
+	grid->operand_count = 0;
+	grid->bounded_count = 0;
+	grid->columns = 0;
+	grid->rows = 0;
+	grid->cell_start = 0;
+	grid->cell_operands = 0;
+	return grid;
+}
+
+static void light_grid_clear(LightGrid* grid) {
+	free(grid->operands);
+	free(grid->cell_start);
+	free(grid->cell_operands);
+	grid->operands = 0;
+	grid->operand_count = 0;
+	grid->bounded_count = 0;
+	grid->columns = 0;
+	grid->rows = 0;
+	grid->cell_start = 0;
+	grid->cell_operands = 0;
+}
+
+void light_grid_free(LightGrid* grid) {
+	light_grid_clear(grid);
+	free(grid);
+}
+
+static void light_grid_project(const LightGrid* grid, LightGridOperand* operand) {
+	operand->min_u = operand->min_v = INFINITY;
+	operand->max_u = operand->max_v = -INFINITY;
+	const Bounds* b = &operand->bounds;
+	for (int i = 0; i < 8; ++i) {
+		Vec3 corner = (Vec3){
+			(i & 1) ? b->max.x : b->min.x,
+			(i & 2) ? b->max.y : b->min.y,
+			(i & 4) ? b->max.z : b->min.z
+		};
+		FPType u = vec3_dot(&corner, &grid->u);
+		FPType v = vec3_dot(&corner, &grid->v);
+		operand->min_u = fmin(operand->min_u, u);
+		operand->max_u = fmax(operand->max_u, u);
+		operand->min_v = fmin(operand->min_v, v);
+		operand->max_v = fmax(operand->max_v, v);
+	}
+}
+
+// Cell along one side that c falls in, which may be outside the grid.
+static int light_grid_cell(FPType c, FPType min, FPType size) {
+	FPType i = floor((c - min) / size);
+	if (i < (FPType)-1) { return -1; }
+	if (i > (FPType)LIGHT_GRID_MAX_SIDE) { return LIGHT_GRID_MAX_SIDE; }
+	return (int)i;
+}
+
+static int light_grid_clamp(int i, int count) {
+	return i < 0 ? 0 : (i >= count ? count - 1 : i);
+}
+
+// Range of cells operand covers, inclusive.
+static void light_grid_cells(const LightGrid* grid, const LightGridOperand* operand, int* c0, int* c1, int* r0, int* r1) {
+	*c0 = light_grid_clamp(light_grid_cell(operand->min_u, grid->min_u, grid->cell_width), grid->columns);
+	*c1 = light_grid_clamp(light_grid_cell(operand->max_u, grid->min_u, grid->cell_width), grid->columns);
+	*r0 = light_grid_clamp(light_grid_cell(operand->min_v, grid->min_v, grid->cell_height), grid->rows);
+	*r1 = light_grid_clamp(light_grid_cell(operand->max_v, grid->min_v, grid->cell_height), grid->rows);
+}
+
+void light_grid_update(LightGrid* grid, const Scene* scene, const Vec3* light_dir) {
+	// The address may be reused by a new scene, but never the id.
+	const int id = scene != 0 ? scene_id(scene) : 0;
+	if (grid->scene_id == id && memcmp(&grid->light_dir, light_dir, sizeof(Vec3)) == 0) {
+		grid->scene = scene;
+		return;
+	}
+	light_grid_clear(grid);
+	grid->scene = scene;
+	grid->scene_id = id;
+	grid->light_dir = *light_dir;
+
+	// Any axis not along the light will do to start the plane from.
+	Vec3 a = fabs(light_dir->x) < (FPType)0.5 ? (Vec3){1,0,0} : (Vec3){0,1,0};
+	grid->u = vec3_cross(light_dir, &a);
+	grid->u = vec3_normalize(&grid->u);
+	grid->v = vec3_cross(light_dir, &grid->u);
+
+	int count = scene_union_operands(scene, 0, 0);
+	const Scene** scenes = malloc(sizeof(const Scene*) * (count > 0 ? count : 1));
+	scene_union_operands(scene, scenes, count);
+	grid->operands = malloc(sizeof(LightGridOperand) * (count > 0 ? count : 1));
+	LightGridOperand* unbounded = malloc(sizeof(LightGridOperand) * (count > 0 ? count : 1));
+	int unbounded_count = 0;
+	FPType min_u = INFINITY, max_u = -INFINITY, min_v = INFINITY, max_v = -INFINITY;
+	for (int i = 0; i < count; ++i) {
+		LightGridOperand operand;
+		operand.scene = scenes[i];
+		operand.bounds = scene_bounds(scenes[i]);
+		// Nothing to hit.
+		if (bounds_is_empty(&operand.bounds)) { continue; }
+		light_grid_project(grid, &operand);
+		if (isfinite(operand.min_u) && isfinite(operand.max_u) && isfinite(operand.min_v) && isfinite(operand.max_v)) {
+			grid->operands[grid->bounded_count++] = operand;
+			min_u = fmin(min_u, operand.min_u);
+			max_u = fmax(max_u, operand.max_u);
+			min_v = fmin(min_v, operand.min_v);
+			max_v = fmax(max_v, operand.max_v);
+		} else {
+			unbounded[unbounded_count++] = operand;
+		}
+	}
+	memcpy(grid->operands + grid->bounded_count, unbounded, sizeof(LightGridOperand) * unbounded_count);
+	grid->operand_count = grid->bounded_count + unbounded_count;
+	free(unbounded);
+	free(scenes);
+	if (grid->bounded_count == 0) { return; }
+
+	// Roughly square cells, as many as asked for over the area covered.
+	FPType width = fmax(max_u - min_u, bounds_epsilon);
+	FPType height = fmax(max_v - min_v, bounds_epsilon);
+	FPType size = sqrt(width * height / (FPType)(grid->bounded_count * LIGHT_GRID_CELLS_PER_OPERAND));
+	grid->columns = (int)fmin(ceil(width / size), (FPType)LIGHT_GRID_MAX_SIDE);
+	grid->rows = (int)fmin(ceil(height / size), (FPType)LIGHT_GRID_MAX_SIDE);
+	if (grid->columns < 1) { grid->columns = 1; }
+	if (grid->rows < 1) { grid->rows = 1; }
+	grid->min_u = min_u;
+	grid->min_v = min_v;
+	grid->cell_width = width / (FPType)grid->columns;
+	grid->cell_height = height / (FPType)grid->rows;
+
+	// Counted first so each cell's operands can be packed together.
+	const int cells = grid->columns * grid->rows;
+	grid->cell_start = malloc(sizeof(int) * (cells + 1));
+	memset(grid->cell_start, 0, sizeof(int) * (cells + 1));
+	int c0, c1, r0, r1;
+	for (int i = 0; i < grid->bounded_count; ++i) {
+		light_grid_cells(grid, &grid->operands[i], &c0, &c1, &r0, &r1);
+		for (int row = r0; row <= r1; ++row) {
+			for (int column = c0; column <= c1; ++column) {
+				++grid->cell_start[row * grid->columns + column + 1];
+			}
+		}
+	}
+	for (int i = 0; i < cells; ++i) {
+		grid->cell_start[i + 1] += grid->cell_start[i];
+	}
+	grid->cell_operands = malloc(sizeof(int) * (grid->cell_start[cells] > 0 ? grid->cell_start[cells] : 1));
+	int* filled = malloc(sizeof(int) * cells);
+	memset(filled, 0, sizeof(int) * cells);
+	for (int i = 0; i < grid->bounded_count; ++i) {
+		light_grid_cells(grid, &grid->operands[i], &c0, &c1, &r0, &r1);
+		for (int row = r0; row <= r1; ++row) {
+			for (int column = c0; column <= c1; ++column) {
+				int cell = row * grid->columns + column;
+				grid->cell_operands[grid->cell_start[cell] + filled[cell]++] = i;
+			}
+		}
+	}
+	free(filled);
+}
+
+static CollisionType light_grid_operand_hit(const LightGridOperand* operand, const Ray* ray) {
+	FPType t_near, t_far;
+	if (!bounds_ray_range(&operand->bounds, ray, &t_near, &t_far)) { return None; }
+	return collision_ray_scene(ray, operand->scene).type;
+}
+
+// Goes through the operands a ray from point towards the light may hit, and
+// returns stop as soon as one is hit that way. Otherwise returns Enter if one
+// was entered and None if none were.
+static CollisionType light_grid_trace(const LightGrid* grid, const Vec3* point, CollisionType stop) {
+	Ray ray = ray_init(point, &grid->light_dir);
+	CollisionType result = None;
+	if (grid->bounded_count > 0) {
+		int column = light_grid_cell(vec3_dot(point, &grid->u), grid->min_u, grid->cell_width);
+		int row = light_grid_cell(vec3_dot(point, &grid->v), grid->min_v, grid->cell_height);
+		if (column >= 0 && column < grid->columns && row >= 0 && row < grid->rows) {
+			int cell = row * grid->columns + column;
+			for (int i = grid->cell_start[cell]; i < grid->cell_start[cell + 1]; ++i) {
+				CollisionType hit = light_grid_operand_hit(&grid->operands[grid->cell_operands[i]], &ray);
+				if (hit == stop) { return stop; }
+				if (hit == Enter) { result = Enter; }
+			}
+		}
+	}
+	for (int i = grid->bounded_count; i < grid->operand_count; ++i) {
+		CollisionType hit = light_grid_operand_hit(&grid->operands[i], &ray);
+		if (hit == stop) { return stop; }
+		if (hit == Enter) { result = Enter; }
+	}
+	return result;
+}
+
+int light_grid_is_shadowed(const LightGrid* grid, const Vec3* point) {
+	return light_grid_trace(grid, point, Enter) == Enter;
+}
+
+CollisionType light_grid_shadow_ray(const LightGrid* grid, const Vec3* point) {
+	return light_grid_trace(grid, point, Exit);
+}
@@ -0,0 +1,43 @@
+/*
+ * light_grid.h
+ *
+ *  Created on: 19/10/2026
+ *      Author: clinton
+ */
+
+#ifndef LIGHT_GRID_H_
+#define LIGHT_GRID_H_
+
+#include "types.h"
+#include "vec3.h"
+#include "scene.h"
+
+// Cells the grid aims for per operand it covers, and the most it has along
+// either side.
+#define LIGHT_GRID_CELLS_PER_OPERAND 4
+#define LIGHT_GRID_MAX_SIDE 64
+
+// Shadow rays from a directional light are all parallel, so the operands of
+// the scene's top level union are projected onto the plane across the light
+// and binned in a 2D grid over what they cover. A point can only be shadowed
+// by the operands in the cell it projects to, plus any that are unbounded.
+// Safe to query from several threads at once.
+typedef struct _LightGrid LightGrid;
+
+LightGrid* light_grid_new();
+void light_grid_free(LightGrid* grid);
+
+// Rebuilds the grid if the scene or light changed since it was built. Not
+// safe while it's being queried.
+void light_grid_update(LightGrid* grid, const Scene* scene, const Vec3* light_dir);
+
+// Whether a ray from point towards the light enters the scene.
+int light_grid_is_shadowed(const LightGrid* grid, const Vec3* point);
+
+// Exit if a ray from point towards the light leaves one of the operands
+// first, i.e. point is inside it, and otherwise Enter if it enters the scene
+// and None if it doesn't. Slower than light_grid_is_shadowed(), as it can't
+// stop at the first operand entered.
+CollisionType light_grid_shadow_ray(const LightGrid* grid, const Vec3* point);
+
+#endif /* LIGHT_GRID_H_ */
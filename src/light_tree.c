@@ -0,0 +1,186 @@
+/*
+ * light_tree.c
+ *
+ *  Created on: 19/10/2026
+ *      Author: clinton
+ */
+
+#include <malloc.h>
+#include <memory.h>
+#include <math.h>
+#include "bounds.h"
+#include "light_tree.h"
+
+typedef struct {
+	Bounds bounds; // of the lights, all of each area light
+	FPType power;
+	// Children, or -1 for a leaf holding one light.
+	int left;
+	int right;
+	int light;
+}LightTreeNode;
+
+struct _LightTree {
+	Light* lights;
+	int light_count;
+	LightTreeNode* nodes; // the root first
+	int node_count;
+};
+
+static FPType light_tree_coordinate(const Light* light, int axis) {
+	return (&light->position.x)[axis];
+}
+
+static Bounds light_tree_light_bounds(const Light* light) {
+	Vec3 extent = (Vec3){
+		fabs(light->axis_u.x) + fabs(light->axis_v.x),
+		fabs(light->axis_u.y) + fabs(light->axis_v.y),
+		fabs(light->axis_u.z) + fabs(light->axis_v.z)
+	};
+	Vec3 min = vec3_sub(&light->position, &extent);
+	Vec3 max = vec3_add(&light->position, &extent);
+	return bounds_init(&min, &max);
+}
+
+// Reorders lights so the one at nth is where it would be if they were sorted
+// along axis, with none after it less and none before it greater.
+static void light_tree_select(Light* lights, int count, int nth, int axis) {
+	int lo = 0, hi = count - 1;
+	while (lo < hi) {
+		FPType pivot = light_tree_coordinate(&lights[(lo + hi) / 2], axis);
+		int i = lo, j = hi;
+		while (i <= j) {
+			while (light_tree_coordinate(&lights[i], axis) < pivot) { ++i; }
+			while (light_tree_coordinate(&lights[j], axis) > pivot) { --j; }
+			if (i <= j) {
+				Light tmp = lights[i];
+				lights[i] = lights[j];
+				lights[j] = tmp;
+				++i;
+				--j;
+			}
+		}
+		if (nth <= j) {
+			hi = j;
+		} else if (nth >= i) {
+			lo = i;
+		} else {
+			break;
+		}
+	}
+}
+
+// Builds the node for lights first to first + count - 1, splitting them in
+// half along the axis their positions spread furthest on. Returns its index.
+static int light_tree_build(LightTree* tree, int first, int count) {
+	int index = tree->node_count++;
+	LightTreeNode* node = &tree->nodes[index];
+	node->bounds = bounds_empty();
+	node->power = 0;
+	for (int i = first; i < first + count; ++i) {
+		const Light* light = &tree->lights[i];
+		Bounds b = light_tree_light_bounds(light);
+		node->bounds = bounds_union(&node->bounds, &b);
+		node->power += light_power(light);
+	}
+	if (count == 1) {
+		node->left = node->right = -1;
+		node->light = first;
+		return index;
+	}
+	Vec3 size = vec3_sub(&node->bounds.max, &node->bounds.min);
+	int axis = size.x >= size.y && size.x >= size.z ? 0 : (size.y >= size.z ? 1 : 2);
+	int half = count / 2;
+	light_tree_select(tree->lights + first, count, half, axis);
+	node->light = -1;
+	node->left = light_tree_build(tree, first, half);
+	node->right = light_tree_build(tree, first + half, count - half);
+	return index;
+}
+
+LightTree* light_tree_new(const Light* lights, int count) {
+	LightTree* tree = malloc(sizeof(LightTree));
+	tree->light_count = count;
+	tree->lights = malloc(sizeof(Light) * (count > 0 ? count : 1));
+	memcpy(tree->lights, lights, sizeof(Light) * count);
+	tree->nodes = malloc(sizeof(LightTreeNode) * (count > 0 ? 2 * count - 1 : 1));
+	tree->node_count = 0;
+	if (count > 0) {
+		light_tree_build(tree, 0, count);
+	}
+	return tree;
+}
+
+void light_tree_free(LightTree* tree) {
+	free(tree->lights);
+	free(tree->nodes);
+	free(tree);
+}
+
+int light_tree_light_count(const LightTree* tree) {
+	return tree->light_count;
+}
+
+// Estimate of what the node's lights could give the point, or 0 if they
+// can't give it anything because they're all behind the surface. For a
+// single point or spot light it's exactly what it gives, shadows aside. An
+// area light could light the point from any part of it, so is estimated
+// from its bounds like a group.
+static FPType light_tree_importance(const LightTree* tree, const LightTreeNode* node, const Vec3* point, const Vec3* normal) {
+	if (node->light >= 0 && !light_is_area(&tree->lights[node->light])) {
+		Vec3 to_light;
+		FPType distance;
+		Colour c = light_illuminate(&tree->lights[node->light], point, normal, &to_light, &distance);
+		return (c.red + c.green + c.blue) / (FPType)3;
+	}
+	const Bounds* b = &node->bounds;
+	int in_front = 0;
+	for (int i = 0; i < 8 && !in_front; ++i) {
+		Vec3 corner = (Vec3){
+			(i & 1) ? b->max.x : b->min.x,
+			(i & 2) ? b->max.y : b->min.y,
+			(i & 4) ? b->max.z : b->min.z
+		};
+		Vec3 v = vec3_sub(&corner, point);
+		in_front = vec3_dot(&v, normal) > (FPType)0;
+	}
+	if (!in_front) { return 0; }
+	Vec3 centre = vec3_add(&b->min, &b->max);
+	centre = vec3_scale(&centre, (FPType)0.5);
+	Vec3 v = vec3_sub(&centre, point);
+	Vec3 diagonal = vec3_sub(&b->max, &b->min);
+	// Nearer than the node's own size, its lights could be anywhere around
+	// the point, so it's treated as being that far away.
+	FPType distance_squared = fmax(vec3_length_squared(&v), vec3_length_squared(&diagonal) * (FPType)0.25);
+	if (distance_squared == (FPType)0) { return node->power; }
+	return node->power / distance_squared;
+}
+
+const Light* light_tree_sample(const LightTree* tree, const Vec3* point, const Vec3* normal, FPType u, FPType* probability) {
+	if (tree->node_count == 0) { return 0; }
+	const LightTreeNode* node = &tree->nodes[0];
+	FPType p = 1;
+	while (node->light < 0) {
+		const LightTreeNode* left = &tree->nodes[node->left];
+		const LightTreeNode* right = &tree->nodes[node->right];
+		FPType left_importance = light_tree_importance(tree, left, point, normal);
+		FPType right_importance = light_tree_importance(tree, right, point, normal);
+		FPType total = left_importance + right_importance;
+		if (!(total > (FPType)0)) { return 0; }
+		FPType p_left = left_importance / total;
+		// u is reused for the next choice down by stretching whichever part
+		// of [0, 1) was taken back over it.
+		if (u < p_left) {
+			node = left;
+			p *= p_left;
+			u /= p_left;
+		} else {
+			node = right;
+			p *= (FPType)1 - p_left;
+			u = (u - p_left) / ((FPType)1 - p_left);
+		}
+		if (u >= (FPType)1) { u = nextafterf((FPType)1, (FPType)0); }
+	}
+	*probability = p;
+	return &tree->lights[node->light];
+}
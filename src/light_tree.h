@@ -0,0 +1,33 @@
+/*
+ * light_tree.h
+ *
+ *  Created on: 19/10/2026
+ *      Author: clinton
+ */
+
+#ifndef LIGHT_TREE_H_
+#define LIGHT_TREE_H_
+
+#include "types.h"
+#include "vec3.h"
+#include "light.h"
+
+// Bounding volume hierarchy over a set of lights, each node bounding where
+// its lights are and how much power they have between them. Picking a light
+// to shade a point walks down it, choosing each child in proportion to an
+// estimate of what it could give the point, so the cost doesn't grow with
+// the number of lights. Safe to sample from several threads at once.
+typedef struct _LightTree LightTree;
+
+// Copies the lights.
+LightTree* light_tree_new(const Light* lights, int count);
+void light_tree_free(LightTree* tree);
+
+int light_tree_light_count(const LightTree* tree);
+
+// Picks a light to shade point, on a surface facing normal, with u uniform
+// in [0, 1). Every light that could light the point has a chance of being
+// picked, which is written to *probability. Returns 0 if none could.
+const Light* light_tree_sample(const LightTree* tree, const Vec3* point, const Vec3* normal, FPType u, FPType* probability);
+
+#endif /* LIGHT_TREE_H_ */
@@ -0,0 +1,241 @@
+/*
+ * presenter.c
+ *
+ *  Created on: 19/10/2026
+ *      Author: clinton
+ */
+
+#include <malloc.h>
+#include "aligned.h"
+#include "presenter.h"
+
+typedef struct {
+	SDL_Surface* surface;
+	void* pixels; // of the surface, which doesn't free them
+	// The frame converted to the screen's format, so all that's left to do
+	// on the main thread is copy it. A plain software surface, so nothing
+	// but memory is touched converting to it off the main thread.
+	SDL_Surface* display;
+	Uint32 started;
+	// What it's in use for. It's free for the renderer when none are set.
+	int rendering;
+	int queued;
+	// Set once a queued buffer's display surface holds the frame.
+	int converted;
+}PresentBuffer;
+
+struct _Presenter {
+	SDL_Surface* screen;
+	// One for each frame that may be queued, plus one each being rendered
+	// and kept on screen.
+	PresentBuffer* buffers;
+	int buffer_count;
+	SDL_Thread* thread;
+	// Guards everything below, and is signalled whenever there's something
+	// for the thread to do.
+	SDL_mutex* mutex;
+	SDL_cond* wake;
+	// Ring of queued buffers.
+	PresentBuffer** queue;
+	int queue_depth;
+	int queue_start;
+	int queue_count;
+	// Last frame presented, for refreshing.
+	PresentBuffer* shown;
+	int quit;
+	int frames;
+	Uint32 first_presented;
+	Uint32 last_presented;
+	Uint32 total_latency;
+	LatencyHistogram latency;
+};
+
+static int present_buffer_is_free(const Presenter* presenter, const PresentBuffer* buffer) {
+	return !buffer->rendering && !buffer->queued && buffer != presenter->shown;
+}
+
+static PresentBuffer* presenter_find(Presenter* presenter, SDL_Surface* surface) {
+	for (int i = 0; i < presenter->buffer_count; ++i) {
+		if (presenter->buffers[i].surface == surface) { return &presenter->buffers[i]; }
+	}
+	return 0;
+}
+
+// First queued buffer not converted yet, in the order they're presented.
+static PresentBuffer* presenter_next_to_convert(Presenter* presenter) {
+	for (int i = 0; i < presenter->queue_count; ++i) {
+		PresentBuffer* buffer = presenter->queue[(presenter->queue_start + i) % presenter->queue_depth];
+		if (!buffer->converted) { return buffer; }
+	}
+	return 0;
+}
+
+// Only converts frames, between surfaces of its own, as SDL video calls
+// aren't safe from any thread but the main one.
+static int presenter_main(void* data) {
+	Presenter* presenter = data;
+	SDL_LockMutex(presenter->mutex);
+	for (;;) {
+		PresentBuffer* buffer = presenter_next_to_convert(presenter);
+		if (buffer == 0) {
+			if (presenter->quit) { break; }
+			SDL_CondWait(presenter->wake, presenter->mutex);
+			continue;
+		}
+		SDL_UnlockMutex(presenter->mutex);
+		SDL_BlitSurface(buffer->surface, 0, buffer->display, 0);
+		SDL_LockMutex(presenter->mutex);
+		buffer->converted = 1;
+	}
+	SDL_UnlockMutex(presenter->mutex);
+	return 0;
+}
+
+Presenter* presenter_new(SDL_Surface* screen, int queue_depth) {
+	if (queue_depth < 1) { queue_depth = 1; }
+	Presenter* presenter = malloc(sizeof(Presenter));
+	presenter->screen = screen;
+	presenter->buffer_count = queue_depth + 2;
+	presenter->buffers = malloc(sizeof(PresentBuffer) * presenter->buffer_count);
+	for (int i = 0; i < presenter->buffer_count; ++i) {
+		PresentBuffer* buffer = &presenter->buffers[i];
+		// Frames are packed as BGRA bytes, and the blit converts to the
+		// screen. The pixels are allocated here so the rows are aligned for
+		// tonemap_pack() to stream them.
+		const int pitch = (screen->w * 4 + ALIGNED_BYTES - 1) & ~(ALIGNED_BYTES - 1);
+		buffer->pixels = aligned_malloc(pitch * screen->h);
+#if SDL_BYTEORDER == SDL_BIG_ENDIAN
+		buffer->surface = SDL_CreateRGBSurfaceFrom(buffer->pixels, screen->w, screen->h, 32, pitch, 0x0000ff00, 0x00ff0000, 0xff000000, 0);
+#else
+		buffer->surface = SDL_CreateRGBSurfaceFrom(buffer->pixels, screen->w, screen->h, 32, pitch, 0x00ff0000, 0x0000ff00, 0x000000ff, 0);
+#endif
+		// Not SDL_DisplayFormat(), which may make a hardware surface like
+		// the screen.
+		const SDL_PixelFormat* format = screen->format;
+		buffer->display = SDL_CreateRGBSurface(SDL_SWSURFACE, screen->w, screen->h, format->BitsPerPixel,
+			format->Rmask, format->Gmask, format->Bmask, format->Amask);
+		buffer->started = 0;
+		buffer->rendering = 0;
+		buffer->queued = 0;
+		buffer->converted = 0;
+	}
+	presenter->mutex = SDL_CreateMutex();
+	presenter->wake = SDL_CreateCond();
+	presenter->queue = malloc(sizeof(PresentBuffer*) * queue_depth);
+	presenter->queue_depth = queue_depth;
+	presenter->queue_start = 0;
+	presenter->queue_count = 0;
+	presenter->shown = 0;
+	presenter->quit = 0;
+	presenter->frames = 0;
+	presenter->first_presented = 0;
+	presenter->last_presented = 0;
+	presenter->total_latency = 0;
+	presenter->latency = latency_histogram_init();
+	presenter->thread = SDL_CreateThread(presenter_main, presenter);
+	return presenter;
+}
+
+void presenter_free(Presenter* presenter) {
+	SDL_LockMutex(presenter->mutex);
+	presenter->quit = 1;
+	SDL_CondSignal(presenter->wake);
+	SDL_UnlockMutex(presenter->mutex);
+	SDL_WaitThread(presenter->thread, 0);
+	while (presenter_present(presenter)) {}
+	for (int i = 0; i < presenter->buffer_count; ++i) {
+		SDL_FreeSurface(presenter->buffers[i].display);
+		SDL_FreeSurface(presenter->buffers[i].surface);
+		aligned_free(presenter->buffers[i].pixels);
+	}
+	SDL_DestroyCond(presenter->wake);
+	SDL_DestroyMutex(presenter->mutex);
+	free(presenter->buffers);
+	free(presenter->queue);
+	free(presenter);
+}
+
+SDL_Surface* presenter_acquire(Presenter* presenter) {
+	SDL_LockMutex(presenter->mutex);
+	PresentBuffer* buffer = 0;
+	if (presenter->queue_count < presenter->queue_depth) {
+		for (int i = 0; i < presenter->buffer_count && buffer == 0; ++i) {
+			if (present_buffer_is_free(presenter, &presenter->buffers[i])) {
+				buffer = &presenter->buffers[i];
+			}
+		}
+	}
+	if (buffer != 0) {
+		buffer->rendering = 1;
+	}
+	SDL_UnlockMutex(presenter->mutex);
+	if (buffer == 0) { return 0; }
+	return buffer->surface;
+}
+
+void presenter_submit(Presenter* presenter, SDL_Surface* surface, Uint32 started) {
+	PresentBuffer* buffer = presenter_find(presenter, surface);
+	SDL_LockMutex(presenter->mutex);
+	buffer->rendering = 0;
+	buffer->queued = 1;
+	buffer->converted = 0;
+	buffer->started = started;
+	presenter->queue[(presenter->queue_start + presenter->queue_count) % presenter->queue_depth] = buffer;
+	++presenter->queue_count;
+	SDL_CondSignal(presenter->wake);
+	SDL_UnlockMutex(presenter->mutex);
+}
+
+void presenter_discard(Presenter* presenter, SDL_Surface* surface) {
+	PresentBuffer* buffer = presenter_find(presenter, surface);
+	SDL_LockMutex(presenter->mutex);
+	buffer->rendering = 0;
+	SDL_UnlockMutex(presenter->mutex);
+}
+
+int presenter_present(Presenter* presenter) {
+	SDL_LockMutex(presenter->mutex);
+	PresentBuffer* buffer = 0;
+	if (presenter->queue_count > 0 && presenter->queue[presenter->queue_start]->converted) {
+		buffer = presenter->queue[presenter->queue_start];
+		presenter->queue_start = (presenter->queue_start + 1) % presenter->queue_depth;
+		--presenter->queue_count;
+		buffer->queued = 0;
+		// Keeps it from being handed out while it's blitted.
+		presenter->shown = buffer;
+	}
+	SDL_UnlockMutex(presenter->mutex);
+	if (buffer == 0) { return 0; }
+	SDL_BlitSurface(buffer->display, 0, presenter->screen, 0);
+	SDL_Flip(presenter->screen);
+	Uint32 now = SDL_GetTicks();
+	SDL_LockMutex(presenter->mutex);
+	Uint32 latency = now - buffer->started;
+	if (presenter->frames == 0) { presenter->first_presented = now; }
+	presenter->last_presented = now;
+	presenter->total_latency += latency;
+	latency_histogram_add(&presenter->latency, latency);
+	++presenter->frames;
+	SDL_UnlockMutex(presenter->mutex);
+	return 1;
+}
+
+void presenter_refresh(Presenter* presenter) {
+	// Only the main thread changes which is shown, so it can't change here.
+	if (presenter->shown == 0) { return; }
+	SDL_BlitSurface(presenter->shown->display, 0, presenter->screen, 0);
+	SDL_Flip(presenter->screen);
+}
+
+PresenterStats presenter_stats(Presenter* presenter) {
+	SDL_LockMutex(presenter->mutex);
+	PresenterStats stats;
+	stats.frames = presenter->frames;
+	Uint32 span = presenter->last_presented - presenter->first_presented;
+	stats.frames_per_second = span == 0 ? (FPType)0 : (FPType)(presenter->frames - 1) * (FPType)1000 / (FPType)span;
+	stats.average_latency = presenter->frames == 0 ? (FPType)0 : (FPType)presenter->total_latency / (FPType)(presenter->frames * 1000);
+	stats.max_latency = (FPType)presenter->latency.max / (FPType)1000;
+	stats.latency = presenter->latency;
+	SDL_UnlockMutex(presenter->mutex);
+	return stats;
+}
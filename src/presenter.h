@@ -0,0 +1,57 @@
+/*
+ * presenter.h
+ *
+ *  Created on: 19/10/2026
+ *      Author: clinton
+ */
+
+#ifndef PRESENTER_H_
+#define PRESENTER_H_
+
+#include <SDL.h>
+#include "types.h"
+#include "latency_histogram.h"
+
+// Frames waiting to be presented at most. Each one waiting adds a frame of
+// latency, so rendering stalls rather than queue more.
+#define PRESENTER_QUEUE_DEPTH 1
+
+// Converts finished frames to the screen's format on a thread of its own, so
+// the next frame can be rendered meanwhile, leaving only the blit and flip to
+// the main thread as SDL's video calls must all be made from the one thread.
+// Frames are packed into 32 bit BGRA surfaces it hands out, with rows aligned
+// to ALIGNED_BYTES.
+typedef struct _Presenter Presenter;
+
+typedef struct {
+	int frames; // presented
+	FPType frames_per_second; // from the first frame presented to the last
+	// Seconds from a frame being started to it being flipped to the screen.
+	FPType average_latency;
+	FPType max_latency;
+	LatencyHistogram latency;
+}PresenterStats;
+
+Presenter* presenter_new(SDL_Surface* screen, int queue_depth);
+// Presents whatever is still queued first.
+void presenter_free(Presenter* presenter);
+
+// Returns a surface to put the next frame in, or 0 if the queue is full.
+// What it holds is left over from an earlier frame, so the whole frame
+// must be written.
+SDL_Surface* presenter_acquire(Presenter* presenter);
+// Queues the acquired surface to be presented. started is the SDL ticks when
+// the frame was started, for measuring latency.
+void presenter_submit(Presenter* presenter, SDL_Surface* surface, Uint32 started);
+// Gives back the acquired surface without presenting it.
+void presenter_discard(Presenter* presenter, SDL_Surface* surface);
+// Flips the next queued frame to the screen if it's been converted. Returns
+// non-zero if there was one. Main thread only, like the rest of SDL's video.
+int presenter_present(Presenter* presenter);
+// Presents the last frame again, e.g. after the window was exposed. Main
+// thread only.
+void presenter_refresh(Presenter* presenter);
+
+PresenterStats presenter_stats(Presenter* presenter);
+
+#endif /* PRESENTER_H_ */
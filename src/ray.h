@@ -11,17 +11,42 @@
 #include "types.h"
 #include "vec3.h"
 
+// Tolerance on |direction|^2 for a ray to be treated as unit length.
+static const FPType ray_unit_epsilon = (FPType)1e-6;
+
+// Besides origin and direction a ray carries data derived from its direction
+// so the kernels don't redo it per node. Always build rays with ray_init()
+// or the helpers below so it stays consistent.
 typedef struct {
 	Vec3 origin;
 	Vec3 direction;
+	Vec3 inv_direction; // +-inf along axes the ray doesn't move on
+	int octant; // bit i set if the direction is negative along axis i
+	int unit; // non-zero if |direction| == 1
 }Ray;
 
 static inline Ray ray_init(const Vec3* origin, const Vec3* direction) {
-	return (Ray){*origin, *direction};
+	Vec3 inv = (Vec3){
+		(FPType)1 / direction->x,
+		(FPType)1 / direction->y,
+		(FPType)1 / direction->z
+	};
+	// Taken from the reciprocal so -0 counts as negative, matching its -inf.
+	int octant = (inv.x < (FPType)0) | ((inv.y < (FPType)0) << 1) | ((inv.z < (FPType)0) << 2);
+	FPType length_squared = vec3_dot(direction, direction);
+	return (Ray){
+		.origin = *origin,
+		.direction = *direction,
+		.inv_direction = inv,
+		.octant = octant,
+		.unit = fabs(length_squared - (FPType)1) < ray_unit_epsilon
+	};
 }
 
 static inline Ray ray_set_origin(const Ray* ray, const Vec3* origin) {
-	return ray_init(origin, &ray->direction);
+	Ray result = *ray;
+	result.origin = *origin;
+	return result;
 }
 
 static inline Ray ray_set_direction(const Ray* ray, const Vec3* direction) {
@@ -10,6 +10,7 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <memory.h>
 #include <SDL.h>
 #ifdef _WIN32
 #include <windows.h>
@@ -17,15 +18,91 @@
 #include "config.h"
 #include "camera.h"
 #include "scene.h"
+#include "render.h"
+#include "render_job.h"
+#include "frame_budget.h"
+#include "presenter.h"
+#include "frame_pacer.h"
+#include "tonemap.h"
+#include "aligned.h"
 
 static const int SCREEN_WIDTH = 640;
 static const int SCREEN_HEIGHT = 480;
-static const int SCREEN_BPP = 24;
+static const int SCREEN_BPP = 32;
+
+// What the rendered light is scaled by before it's clamped for display, and
+// where C saves what's on screen.
+static const FPType EXPOSURE = 1;
+static const char* SCREENSHOT_PATH = "screenshot.ppm";
+
+// Frames traced with scene profiling on before the CSG operands are reordered
+// using what was measured.
+static const int SCENE_PROFILE_FRAMES = 2;
+
+// Frame time aimed for while the camera moves, and the lowest resolution
+// scale used to reach it. Once it stops the frame is refined at full
+// resolution.
+static const FPType FRAME_TIME_BUDGET = 1.0 / 60.0;
+static const FPType MIN_RESOLUTION_SCALE = 0.25;
+
+// Degrees per second the camera turns and units per second it moves while
+// a key is held. A stall longer than MAX_CAMERA_STEP seconds only moves it
+// that far.
+static const FPType TURN_SPEED = 120;
+static const FPType MOVE_SPEED = 200;
+static const FPType MAX_CAMERA_STEP = 0.1;
+
+// The point lights are laid out in a grid this many on a side a little above
+// the floor, with a few spot lights shining down on the objects and a
+// couple of area lights beside them casting soft shadows. The scene is only
+// lit by them once F is pressed, as every shading point samples them on
+// top of the directional light.
+static const int POINT_LIGHT_SIDE = 12;
+static const int SPOT_LIGHT_COUNT = 3;
+static const int AREA_LIGHT_COUNT = 2;
 
 static SDL_Surface* screen = 0;
+static Presenter* presenter = 0;
 static int done = 0;
+static int exposed = 0;
+static int frames_rendered = 0;
+static int frames_skipped = 0;
+static int frames_cancelled = 0;
 static Scene* scene = 0;
+static Light* lights = 0;
+static int light_count = 0;
+// Whether the lights are wanted, and whether the renderer has them.
+static int lights_on = 0;
+static int lights_applied = 0;
 static Camera camera;
+// Ticks when the camera was last moved.
+static Uint32 camera_ticks = 0;
+static Renderer* renderer = 0;
+// Settings as chosen with the keyboard, and as last given to the renderer.
+static RenderSettings settings;
+static RenderSettings applied;
+static FrameBudget frame_budget;
+// Pass being traced, if any, the surface it's traced into, when it started,
+// whether the camera was moving then and whether it has been cancelled.
+static RenderJob* job = 0;
+static SDL_Surface* job_surface = 0;
+// What the renderer writes into, kept from frame to frame as each pass only
+// writes what changed. Packed into a surface once the pass is done.
+static float* framebuffer = 0;
+static int screenshot_wanted = 0;
+static Uint32 job_started = 0;
+static int job_moving = 0;
+static int job_cancelled = 0;
+static int dynamic_resolution = 1;
+
+static int left_down = 0;
+static int right_down = 0;
+static int down_down = 0;
+static int up_down = 0;
+static int w_down = 0;
+static int s_down = 0;
+static int a_down = 0;
+static int d_down = 0;
 
 static void init_scene() {
 	camera = camera_init();
@@ -68,6 +145,34 @@ static void init_scene() {
 		scene,
 		scene_box(&box)
 	);
+	light_count = POINT_LIGHT_SIDE * POINT_LIGHT_SIDE + SPOT_LIGHT_COUNT + AREA_LIGHT_COUNT;
+	lights = malloc(sizeof(Light) * light_count);
+	for (int j = 0; j < POINT_LIGHT_SIDE; ++j) {
+		for (int i = 0; i < POINT_LIGHT_SIDE; ++i) {
+			FPType fi = (FPType)i / (FPType)(POINT_LIGHT_SIDE - 1);
+			FPType fj = (FPType)j / (FPType)(POINT_LIGHT_SIDE - 1);
+			Vec3 position = (Vec3){-400 + 800 * fi, -20, -600 + 550 * fj};
+			Colour colour = (Colour){20 + 40 * fi, 20, 20 + 40 * fj};
+			lights[j * POINT_LIGHT_SIDE + i] = light_point(&position, &colour);
+		}
+	}
+	{
+		Vec3 down = (Vec3){0,-1,0};
+		Vec3 positions[] = {{-40,250,-200}, {100,250,-250}, {-250,250,-350}};
+		Colour colour = (Colour){20000, 20000, 16000};
+		for (int i = 0; i < SPOT_LIGHT_COUNT; ++i) {
+			lights[POINT_LIGHT_SIDE * POINT_LIGHT_SIDE + i] = light_spot(&positions[i], &colour, &down, 15, 25);
+		}
+	}
+	{
+		Vec3 down = (Vec3){0,-1,0};
+		Vec3 rect_position = (Vec3){200,150,-150};
+		Vec3 disk_position = (Vec3){-200,150,-80};
+		Colour colour = (Colour){16000, 18000, 20000};
+		Light* area_lights = lights + POINT_LIGHT_SIDE * POINT_LIGHT_SIDE + SPOT_LIGHT_COUNT;
+		area_lights[0] = light_rect(&rect_position, &colour, &down, 120, 60);
+		area_lights[1] = light_disk(&disk_position, &colour, &down, 30);
+	}
 	//scene_unref(scene);
 	//scene = scene_box(&box);
 	/*
@@ -93,81 +198,53 @@ static void init_scene() {
 }
 
 static void final_scene() {
+	renderer_free(renderer);
+	aligned_free(framebuffer);
 	scene_unref(scene);
+	free(lights);
 }
 
 static void init_video() {
 	int video_flags = SDL_DOUBLEBUF | SDL_HWACCEL | SDL_HWSURFACE;
 	screen = SDL_SetVideoMode(SCREEN_WIDTH, SCREEN_HEIGHT, SCREEN_BPP, video_flags);
+	presenter = presenter_new(screen, PRESENTER_QUEUE_DEPTH);
 	SDL_WM_SetCaption("Raytracer", 0);
 }
 
-static void draw() {
-	unsigned char* pixels = screen->pixels;
-	if (SDL_MUSTLOCK(screen)) {
-		SDL_LockSurface(screen);
-	}
-	Vec3 light_dir = (Vec3){1,1,1};
-	light_dir = vec3_normalize(&light_dir);
-	int offset1 = 0;
-	for (int y = 0; y < SCREEN_HEIGHT; ++y) {
-		int offset2 = 0;
-		for (int x = 0; x < SCREEN_WIDTH; ++x) {
-			Ray ray = camera_screen_coord_to_ray(&camera, x, y, SCREEN_WIDTH, SCREEN_HEIGHT);
-			CollisionResult cr = collision_ray_scene(&ray, scene);
-			if (cr.type == Enter) {
-				Colour clr = cr.colour;
-				FPType reflectiveness = cr.reflectiveness;
-				Vec3 point = ray_point(&ray, cr.time);
-				FPType a = vec3_dot(&light_dir, &cr.normal);
-				if (a < 0.3) { a = 0.3; }
-
-				if (reflectiveness > (FPType)0.0) {
-					Vec3 rd = vec3_reflect(&ray.direction, &cr.normal);
-					Ray ray2 = ray_init(&point, &rd);
-					Vec3 ro = ray_point(&ray2, 0.1);
-					ray2 = ray_init(&ro, &rd);
-					cr = collision_ray_scene(&ray2, scene);
-					clr = colour_mix(&clr, &cr.colour, reflectiveness);
-				}
-
-				{
-					Vec3 ro = ray_point(&ray, cr.time);
-					ray = ray_init(&ro, &light_dir);
-					ro = ray_point(&ray, (FPType)0.1);
-					ray = ray_init(&ro, &light_dir);
-				}
-				cr = collision_ray_scene(&ray, scene);
-				if (cr.type == Enter) {
-					// Shadow
-					a *= 0.8;
-					if (a < 0.3) { a = 0.3; }
-				}
-
-				if (a < (FPType)0) { a = (FPType)0; }
-				if (a > (FPType)1) { a = (FPType)1; }
-				if (clr.red < (FPType)0) { clr.red = (FPType)0; }
-				if (clr.green < (FPType)0) { clr.green = (FPType)0; }
-				if (clr.blue < (FPType)0) { clr.blue = (FPType)0; }
-				if (clr.red > (FPType)1) { clr.red = (FPType)1; }
-				if (clr.green > (FPType)1) { clr.green = (FPType)1; }
-				if (clr.blue > (FPType)1) { clr.blue = (FPType)1; }
-				pixels[offset1+offset2+2] = (unsigned char)(255*a*clr.red);
-				pixels[offset1+offset2+1] = (unsigned char)(255*a*clr.green);
-				pixels[offset1+offset2+0] = (unsigned char)(255*a*clr.blue);
-			} else {
-				pixels[offset1+offset2+2] = 0;
-				pixels[offset1+offset2+1] = 0;
-				pixels[offset1+offset2+0] = 0;
-			}
-			offset2 += 3;
-		}
-		offset1 += screen->pitch;
-	}
-	if (SDL_MUSTLOCK(screen)) {
-		SDL_UnlockSurface(screen);
+static void final_video() {
+	presenter_free(presenter);
+}
+
+static void show_stats() {
+	RenderStats stats = renderer_stats(renderer);
+	PresenterStats present_stats = presenter_stats(presenter);
+	char caption[256];
+	if (applied.path_trace) {
+		sprintf(caption, "Raytracer - path tracing, %.0f samples per pixel, %.2f path length, %.2f million samples per second, %.1f ms denoising, %d%% resolution, %.0f fps", render_stats_samples_per_pixel(&stats), render_stats_average_path_length(&stats), renderer_path_samples_per_second(renderer) / 1e6, applied.denoise ? renderer_denoise_time(renderer) * 1000 : 0, (int)(applied.scale * 100 + 0.5), present_stats.frames_per_second);
+		SDL_WM_SetCaption(caption, 0);
+		return;
 	}
-	SDL_Flip(screen);
+	sprintf(caption, "Raytracer - %.2f samples per pixel, %.2f path length, %d shadow rays, %d edge pixels, %d reprojected, %d%% resolution, %.0f fps, %.0f ms latency", render_stats_samples_per_pixel(&stats), render_stats_average_path_length(&stats), stats.shadow_rays, stats.edge_pixels, stats.reprojected, (int)(applied.scale * 100 + 0.5), present_stats.frames_per_second, present_stats.average_latency * 1000);
+	SDL_WM_SetCaption(caption, 0);
+}
+
+static int any_key_down() {
+	return left_down || right_down || down_down || up_down || w_down || s_down || a_down || d_down;
+}
+
+static void init_renderer() {
+	settings = render_settings_default();
+	applied = settings;
+	frame_budget = frame_budget_init(FRAME_TIME_BUDGET, MIN_RESOLUTION_SCALE);
+	renderer = renderer_new(SCREEN_WIDTH, SCREEN_HEIGHT);
+	const int framebuffer_size = render_target_size(SCREEN_WIDTH, SCREEN_HEIGHT);
+	framebuffer = aligned_malloc(sizeof(float) * 4 * framebuffer_size);
+	memset(framebuffer, 0, sizeof(float) * 4 * framebuffer_size);
+	renderer_set_settings(renderer, &applied);
+	renderer_set_scene(renderer, scene);
+	renderer_set_lights(renderer, lights, lights_on ? light_count : 0);
+	lights_applied = lights_on;
+	renderer_set_camera(renderer, &camera);
 }
 
 static void process_events() {
@@ -177,18 +254,388 @@ static void process_events() {
 		case SDL_QUIT:
 			done = 1;
 			break;
+		case SDL_VIDEOEXPOSE:
+			exposed = 1;
+			break;
+		case SDL_KEYDOWN:
+			switch (event.key.keysym.sym) {
+			case SDLK_LEFT:
+				left_down = 1;
+				break;
+			case SDLK_RIGHT:
+				right_down = 1;
+				break;
+			case SDLK_UP:
+				up_down = 1;
+				break;
+			case SDLK_DOWN:
+				down_down = 1;
+				break;
+			case SDLK_w:
+				w_down = 1;
+				break;
+			case SDLK_s:
+				s_down = 1;
+				break;
+			case SDLK_a:
+				a_down = 1;
+				break;
+			case SDLK_d:
+				d_down = 1;
+				break;
+			case SDLK_p:
+				settings.progressive = !settings.progressive;
+				break;
+			case SDLK_e:
+				settings.antialias = !settings.antialias;
+				break;
+			case SDLK_MINUS:
+				settings.antialias_threshold *= 0.5;
+				break;
+			case SDLK_EQUALS:
+				settings.antialias_threshold *= 2;
+				break;
+			case SDLK_r:
+				dynamic_resolution = !dynamic_resolution;
+				break;
+			case SDLK_i:
+				// Off, every other pixel, then one pixel in four.
+				settings.interleave = settings.interleave >= 4 ? 1 : settings.interleave * 2;
+				break;
+			case SDLK_t:
+				settings.tile_order = settings.tile_order == RenderTileOrder_Centre ? RenderTileOrder_Cost : RenderTileOrder_Centre;
+				break;
+			case SDLK_h:
+				settings.shadow_cache = !settings.shadow_cache;
+				break;
+			case SDLK_g:
+				settings.light_grid = !settings.light_grid;
+				break;
+			case SDLK_l:
+				// Cycles through none and powers of two up to 16.
+				settings.light_samples = settings.light_samples == 0 ? 1 : (settings.light_samples >= 16 ? 0 : settings.light_samples * 2);
+				break;
+			case SDLK_n:
+				settings.adaptive_penumbra = !settings.adaptive_penumbra;
+				break;
+			case SDLK_j:
+				// Cycles through none and powers of two from 4 to 64.
+				settings.ambient_samples = settings.ambient_samples == 0 ? 4 : (settings.ambient_samples >= 64 ? 0 : settings.ambient_samples * 2);
+				break;
+			case SDLK_k:
+				settings.ambient_cache = !settings.ambient_cache;
+				break;
+			case SDLK_m:
+				// Cycles through powers of two up to 16.
+				settings.max_reflection_depth = settings.max_reflection_depth >= 16 ? 1 : settings.max_reflection_depth * 2;
+				break;
+			case SDLK_b:
+				settings.path_trace = !settings.path_trace;
+				break;
+			case SDLK_v:
+				settings.denoise = !settings.denoise;
+				break;
+			case SDLK_c:
+				screenshot_wanted = 1;
+				break;
+			case SDLK_f:
+				lights_on = !lights_on;
+				break;
+			case SDLK_o:
+				settings.ray_sort = (settings.ray_sort + 1) % (RenderRaySort_Auto + 1);
+				break;
+			default:
+				break;
+			}
+			break;
+		case SDL_KEYUP:
+			switch (event.key.keysym.sym) {
+			case SDLK_LEFT:
+				left_down = 0;
+				break;
+			case SDLK_RIGHT:
+				right_down = 0;
+				break;
+			case SDLK_UP:
+				up_down = 0;
+				break;
+			case SDLK_DOWN:
+				down_down = 0;
+				break;
+			case SDLK_w:
+				w_down = 0;
+				break;
+			case SDLK_s:
+				s_down = 0;
+				break;
+			case SDLK_a:
+				a_down = 0;
+				break;
+			case SDLK_d:
+				d_down = 0;
+				break;
+			default:
+				break;
+			}
+			break;
+		default:
+			break;
+		}
+	}
+}
+
+// While the camera moves, drops to the frame budget's scale and traces each
+// frame whole, so every frame drawn is one the budget measured, and cuts
+// reprojected frames off at the budget. Goes back to full resolution and the
+// chosen settings when it stops.
+static RenderSettings wanted_settings() {
+	RenderSettings wanted = settings;
+	if (any_key_down()) {
+		wanted.deadline = FRAME_TIME_BUDGET;
+	}
+	if (dynamic_resolution && any_key_down()) {
+		wanted.scale = frame_budget.scale;
+		wanted.progressive = 0;
+	}
+	return wanted;
+}
+
+// Where the keys held would have moved the camera by now, in the time since
+// it was last moved, so its speed doesn't depend on the frame rate.
+static Camera moved_camera(Uint32 now) {
+	FPType seconds = (now - camera_ticks) / (FPType)1000;
+	if (seconds > MAX_CAMERA_STEP) { seconds = MAX_CAMERA_STEP; }
+	const FPType turn = TURN_SPEED * seconds;
+	const FPType move = MOVE_SPEED * seconds;
+	Camera moved = camera;
+	if (left_down) {
+		moved = camera_turn_left(&moved, turn);
+	}
+	if (right_down) {
+		moved = camera_turn_right(&moved, turn);
+	}
+	if (down_down) {
+		moved = camera_turn_down(&moved, turn);
+	}
+	if (up_down) {
+		moved = camera_turn_up(&moved, turn);
+	}
+	if (w_down) {
+		moved = camera_move_forward(&moved, move);
+	}
+	if (s_down) {
+		moved = camera_move_back(&moved, move);
+	}
+	if (a_down) {
+		moved = camera_move_left(&moved, move);
+	}
+	if (d_down) {
+		moved = camera_move_right(&moved, move);
+	}
+	return moved;
+}
+
+// Moves the camera on to where the keys held have moved it.
+static void move_camera() {
+	Uint32 now = SDL_GetTicks();
+	camera = moved_camera(now);
+	camera_ticks = now;
+}
+
+// The renderer is complete until the camera, scene or settings change, and
+// until then the last frame is still good.
+static int frame_is_current() {
+	RenderSettings wanted = wanted_settings();
+	return renderer_is_complete(renderer) && !any_key_down() && lights_applied == lights_on &&
+		memcmp(&wanted, &applied, sizeof(RenderSettings)) == 0;
+}
+
+// Packs each tile for display as soon as the job has it as it will be shown,
+// on the thread that finished it, so there's little left to pack once the
+// frame is finished.
+static void pack_tile(void* data, RenderJob* job, int tile) {
+	SDL_Surface* surface = data;
+	int x, y, width, height;
+	render_job_tile_rect(job, tile, &x, &y, &width, &height);
+	RenderTarget target = render_target_init(framebuffer, SCREEN_WIDTH);
+	tonemap_pack_rect(&target, x, y, width, height, EXPOSURE, TonemapOrder_BGRA, surface->pixels, surface->pitch);
+}
+
+// Moves the camera on a frame and starts tracing it into the next surface
+// free to present, unless there's nothing new to trace. Returns zero if it
+// has to wait for a surface.
+static int start_frame() {
+	if (frame_is_current()) {
+		if (exposed) {
+			presenter_refresh(presenter);
+			exposed = 0;
 		}
+		// Keys pressed from now on only move the camera from now on.
+		camera_ticks = SDL_GetTicks();
+		++frames_skipped;
+		return 1;
+	}
+	SDL_Surface* surface = presenter_acquire(presenter);
+	if (surface == 0) { return 0; }
+	// Input was sampled just before, so latency is counted from here.
+	job_started = SDL_GetTicks();
+	applied = wanted_settings();
+	move_camera();
+	renderer_set_settings(renderer, &applied);
+	renderer_set_camera(renderer, &camera);
+	if (lights_applied != lights_on) {
+		renderer_set_lights(renderer, lights, lights_on ? light_count : 0);
+		lights_applied = lights_on;
+	}
+	if (renderer_is_complete(renderer)) {
+		presenter_discard(presenter, surface);
+		++frames_skipped;
+		return 1;
+	}
+	RenderTarget target = render_target_init(framebuffer, SCREEN_WIDTH);
+	// Locked for as long as the job's packing tiles into it.
+	if (SDL_MUSTLOCK(surface)) {
+		SDL_LockSurface(surface);
+	}
+	job = render_job_submit(renderer, scene, &camera, &applied, &target, pack_tile, surface);
+	job_surface = surface;
+	job_moving = any_key_down();
+	job_cancelled = 0;
+	return 1;
+}
+
+// Stops tracing a frame once the input has changed what the next one should
+// be, rather than finishing one nobody will see for long. camera is still the
+// one the frame is traced from. A frame traced while moving is stale as soon
+// as it starts, and is cut off at the budget instead.
+static void cancel_stale_frame() {
+	if (job_cancelled) { return; }
+	RenderSettings wanted = wanted_settings();
+	Camera wanted_camera = moved_camera(SDL_GetTicks());
+	int camera_moved = !job_moving && memcmp(&wanted_camera, &camera, sizeof(Camera)) != 0;
+	if (camera_moved || lights_applied != lights_on || memcmp(&wanted, &applied, sizeof(RenderSettings)) != 0) {
+		render_job_cancel(job);
+		job_cancelled = 1;
+	}
+}
+
+static void finish_frame() {
+	int complete = render_job_wait(job);
+	FPType elapsed = render_job_time(job);
+	// Only tiles the pass didn't write, e.g. once the frame was already
+	// complete, are left to pack.
+	if (!job_cancelled) {
+		for (int i = 0; i < render_job_tile_count(job); ++i) {
+			if (!render_job_tile_is_ready(job, i)) {
+				pack_tile(job_surface, job, i);
+			}
+		}
+	}
+	render_job_free(job);
+	job = 0;
+	if (SDL_MUSTLOCK(job_surface)) {
+		SDL_UnlockSurface(job_surface);
+	}
+	if (job_cancelled) {
+		presenter_discard(presenter, job_surface);
+		++frames_cancelled;
+		return;
+	}
+	// Presented while the next frame is traced.
+	presenter_submit(presenter, job_surface, job_started);
+	++frames_rendered;
+	// The job is finished, so nothing is tracing the scene while its
+	// operands are reordered.
+	if (frames_rendered == SCENE_PROFILE_FRAMES) {
+		scene_profile_end(scene);
+	}
+	// A path traced frame is never finished in the time anyone watches it,
+	// so its stats are shown as it converges.
+	if (complete || applied.path_trace) {
+		show_stats();
+	}
+	// Only frames drawn while moving count, as that's when the frame rate
+	// matters.
+	if (dynamic_resolution && job_moving) {
+		// A frame the deadline cut short took as long as it was allowed to,
+		// so estimate what the whole frame would have.
+		RenderStats stats = renderer_stats(renderer);
+		if (stats.tiles_cut > 0) {
+			elapsed *= (FPType)stats.tiles / (FPType)(stats.tiles - stats.tiles_cut > 0 ? stats.tiles - stats.tiles_cut : 1);
+		}
+		frame_budget_update(&frame_budget, elapsed);
+	}
+}
+
+static void save_screenshot() {
+	screenshot_wanted = 0;
+	RenderTarget target = render_target_init(framebuffer, SCREEN_WIDTH);
+	if (tonemap_save_ppm(&target, SCREEN_WIDTH, SCREEN_HEIGHT, EXPOSURE, SCREENSHOT_PATH)) {
+		printf("saved %s\n", SCREENSHOT_PATH);
+	} else {
+		printf("couldn't save %s\n", SCREENSHOT_PATH);
 	}
 }
 
 static void run() {
 	init_scene();
+	// Before the renderer starts its workers. It only changes again between
+	// frames, while they have nothing to do.
+	scene_profile_begin(scene);
+	init_renderer();
 	init_video();
+	FramePacer pacer = frame_pacer_init(FRAME_TIME_BUDGET);
+	int waiting = 0;
 	while (!done) {
-		draw();
-		process_events();
-		SDL_Delay(10);
+		if (job != 0 && render_job_is_finished(job)) {
+			finish_frame();
+		}
+		// Flipped here, as SDL's video calls may only be made from this
+		// thread.
+		presenter_present(presenter);
+		// Only between passes, so it's saved as shown.
+		if (job == 0 && screenshot_wanted) {
+			save_screenshot();
+		}
+		if (job == 0) {
+			// Sleeps off what's left of the frame time before taking input
+			// rather than after, so each frame starts with the latest input.
+			if (!waiting) {
+				frame_pacer_wait(&pacer);
+			}
+			process_events();
+			waiting = !start_frame();
+			if (waiting) {
+				SDL_Delay(1);
+			}
+		} else {
+			// Input is still handled while a frame is traced so a stale one
+			// can be cancelled.
+			SDL_Delay(1);
+			process_events();
+			cancel_stale_frame();
+		}
+	}
+	if (job != 0) {
+		render_job_cancel(job);
+		job_cancelled = 1;
+		finish_frame();
+	}
+	printf("%d frames rendered, %d skipped, %d cancelled\n", frames_rendered, frames_skipped, frames_cancelled);
+	// Throughput and latency are reported apart, as queueing frames raises
+	// one at the cost of the other.
+	PresenterStats present_stats = presenter_stats(presenter);
+	printf("%d frames presented, %.1f per second, %.1f ms average latency, %.1f ms max\n", present_stats.frames, present_stats.frames_per_second, present_stats.average_latency * 1000, present_stats.max_latency * 1000);
+	latency_histogram_print(&present_stats.latency);
+	FPType sort_gain = renderer_ray_sort_gain(renderer);
+	if (sort_gain > (FPType)0) {
+		printf("sorted reflections traced %.2f times as fast\n", sort_gain);
+	}
+	FPType path_rate = renderer_path_samples_per_second(renderer);
+	if (path_rate > (FPType)0) {
+		printf("path traced %.0f samples per second\n", path_rate);
 	}
+	final_video();
 	final_scene();
 }
 
@@ -0,0 +1,1784 @@
+/*
+ * render.c
+ *
+ *  Created on: 19/10/2026
+ *      Author: clinton
+ */
+
+#include <stdlib.h>
+#include <malloc.h>
+#include <memory.h>
+#include <math.h>
+#include <SDL.h>
+#include "render.h"
+#include "camera_rays.h"
+#include "workers.h"
+#include "shadow_cache.h"
+#include "light_grid.h"
+#include "light_tree.h"
+#include "ambient_cache.h"
+#include "timer.h"
+#include "denoise.h"
+#include "aligned.h"
+
+typedef enum {
+	RenderStage_Trace,
+	RenderStage_Reproject,
+	RenderStage_Retrace,
+	RenderStage_Antialias,
+	RenderStage_PathTrace,
+	RenderStage_Complete
+}RenderStage;
+
+// How a run over the tiles ended.
+typedef enum {
+	RenderPass_Finished,
+	RenderPass_Interrupted,
+	// The deadline passed with tiles still to go.
+	RenderPass_Cut
+}RenderPassResult;
+
+// Primitive of a pixel nothing has been reprojected onto yet.
+#define PIXEL_HOLE -1
+
+// What's kept of each pixel's primary sample.
+typedef struct {
+	Colour colour;
+	FPType depth;
+	int primitive;
+	// World space hit point, or the ray direction if nothing was hit.
+	Vec3 point;
+	// Shading depends on where it's seen from, so it can't be reprojected.
+	int view_dependent;
+	// Filled in from neighbours rather than traced, so it isn't reprojected
+	// either.
+	int interpolated;
+}PixelSample;
+
+// What a path first hit, to guide the denoiser.
+typedef struct {
+	Vec3 normal;
+	FPType depth;
+	Colour albedo;
+}PathGuide;
+
+// Depth of a path that hit nothing, as far as the denoiser is concerned.
+#define PATH_MISS_DEPTH 1e6
+
+// Least albedo the denoiser divides by, so pixels that see something nearly
+// black don't blow up.
+#define PATH_MIN_ALBEDO 1e-2
+
+// Rows a worker copies into or out of the denoiser at a time.
+#define PATH_DENOISE_ROWS 8
+
+// What's been path traced of a pixel so far, summed over its samples.
+typedef struct {
+	Colour sum;
+	PathGuide guide;
+	int count;
+}PathPixel;
+
+// Random numbers for one sample of one pixel, the same however the frame is
+// shared out between the workers. Each is hashed from the pixel, the sample,
+// the bounce and how many the bounce has used, so a bounce that uses more or
+// fewer doesn't change those of the bounces after it. Bounce 0 is the camera
+// ray and the path's bounces count from 1.
+typedef struct {
+	unsigned int pixel;
+	unsigned int sample;
+	unsigned int bounce;
+	unsigned int dimension;
+}RenderRandom;
+
+// A reflection to be traced, from a surface that's already been shaded.
+typedef struct {
+	Ray ray;
+	Colour surface; // what it's mixed into
+	FPType reflectiveness;
+	FPType throughput; // of what it hits
+	// Weights what it hits, making up for those Russian roulette stops. 0 if
+	// it stopped this one, which isn't traced at all.
+	FPType scale;
+	int depth; // of what it hits
+	// The pixel and which of its samples it's for, which with the depth
+	// key the roulette.
+	unsigned int pixel;
+	unsigned int subsample;
+	// Where the result goes when it's deferred.
+	PixelSample* sample;
+	int x, y, width, height;
+}RenderReflection;
+
+// First reflections of the tile a worker is on, deferred to be traced
+// together, in an order that keeps rays near each other together.
+typedef struct {
+	RenderReflection* reflections;
+	int count;
+	// Order to trace them in, the keys it's sorted by and room to sort.
+	int* order;
+	unsigned int* keys;
+	int* scratch_order;
+	unsigned int* scratch_keys;
+}RenderReflectionBuffer;
+
+// A part of the frame one worker traces at a time.
+typedef struct {
+	int x, y, width, height;
+	// Rays traced in it in the last frame it was traced in, and so far in
+	// this one.
+	int cost;
+	int rays;
+	// Frames in a row the deadline cut it off. Raises its priority so it
+	// isn't left stale for long.
+	int skipped;
+	FPType priority; // lowest goes first
+	int done; // by the pass in progress
+	int worker; // tracing it
+	int reported; // to the tile done callback, by this renderer_render()
+	// Counts from the pass in progress, added to the frame's after it.
+	RenderStats stats;
+	// Deferred reflections traced in the run in progress, and seconds spent
+	// on them.
+	int reflections;
+	double reflection_time;
+}RenderTile;
+
+struct _Renderer {
+	// Size of the target, and the size traced at once scaled.
+	int output_width;
+	int output_height;
+	int width;
+	int height;
+	// Tiles across the traced size, which the per-pixel buffers are laid
+	// out in like a RenderTarget.
+	int columns;
+	const Scene* scene;
+	// Camera as given, and with its screen depth scaled to the traced size.
+	Camera view;
+	Camera camera;
+	CameraRays* camera_rays;
+	RenderSettings settings;
+	Vec3 light_dir;
+	ShadowCache* shadow_cache;
+	LightGrid* light_grid;
+	AmbientCache* ambient_cache;
+	LightTree* lights; // or 0 if there are none
+	RenderTileDoneFn tile_done_fn;
+	void* tile_done_data;
+	// Whether the pass in progress writes tiles to the target as they'll be
+	// shown, so they can be reported as each is finished rather than all at
+	// the end.
+	int tiles_final;
+	volatile int cancelled;
+	RenderStage stage;
+	// Block size of the trace pass in progress.
+	int step;
+	// The tiles have been ordered for the pass in progress, which was
+	// interrupted if some are done.
+	int pass_started;
+	Workers* workers;
+	RenderTile* tiles;
+	RenderTile** tile_order;
+	int tile_count;
+	// Shared by the workers during a run over the tiles.
+	int next_tile;
+	volatile int stop;
+	RenderReflectionBuffer* reflection_buffers; // one for each worker
+	// Whether the run in progress sorts deferred reflections. To choose for
+	// RenderRaySort_Auto, the average seconds per deferred reflection without
+	// sorting and with, and how many runs each is from.
+	int sort_reflections;
+	FPType reflection_cost[2];
+	int reflection_runs[2];
+	PixelSample* samples;
+	PixelSample* reprojected;
+	// samples holds a complete frame that can be reprojected.
+	int history_valid;
+	int frame;
+	unsigned char* edges;
+	// Traced pixels waiting to be upscaled into the target when scaled.
+	float* scaled;
+	// Accumulated over the passes since the camera, scene or settings
+	// changed when path tracing. Each pixel belongs to one tile, which only
+	// one worker traces at a time, so they're added to without locking.
+	PathPixel* path_pixels;
+	int path_passes; // finished
+	// Samples added to path_pixels, and seconds spent tracing them.
+	double path_samples;
+	double path_seconds;
+	Denoiser* denoiser;
+	double denoise_seconds; // the last time it ran
+	RenderStats stats;
+};
+
+typedef void (*RenderTileFn)(Renderer* renderer, RenderTile* tile, RenderTarget* target);
+
+// A run over the tiles, as seen by each worker.
+typedef struct {
+	Renderer* renderer;
+	RenderTileFn fn;
+	RenderTarget* target;
+	Uint32 deadline; // in SDL ticks, or 0 for none
+}RenderTileRun;
+
+// Copying the path traced pixels into the denoiser, or its result out to
+// the target, as seen by each worker.
+typedef struct {
+	Renderer* renderer;
+	DenoiseImage* image;
+	RenderTarget* target; // 0 while copying in
+	int next_row;
+}RenderDenoiseCopy;
+
+static int renderer_first_step(const Renderer* renderer) {
+	return renderer->settings.progressive ? RENDER_PROGRESSIVE_START_STEP : 1;
+}
+
+static RenderStats render_stats_zero() {
+	return (RenderStats){0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0};
+}
+
+// Adds the counts b made to a.
+static void render_stats_add(RenderStats* a, const RenderStats* b) {
+	a->samples += b->samples;
+	a->rays += b->rays;
+	a->edge_pixels += b->edge_pixels;
+	a->reprojected += b->reprojected;
+	a->interpolated += b->interpolated;
+	a->shadow_rays += b->shadow_rays;
+	a->shadows_cached += b->shadows_cached;
+	a->ambient_cached += b->ambient_cached;
+	a->paths += b->paths;
+	a->path_segments += b->path_segments;
+	a->reflections_sorted += b->reflections_sorted;
+}
+
+static void renderer_update_tiles(Renderer* renderer) {
+	const int columns = render_tiles_spanning(renderer->width);
+	const int rows = render_tiles_spanning(renderer->height);
+	renderer->columns = columns;
+	renderer->tile_count = columns * rows;
+	for (int j = 0; j < rows; ++j) {
+		for (int i = 0; i < columns; ++i) {
+			RenderTile* tile = &renderer->tiles[j * columns + i];
+			tile->x = i * RENDER_TILE_SIZE;
+			tile->y = j * RENDER_TILE_SIZE;
+			tile->width = tile->x + RENDER_TILE_SIZE <= renderer->width ? RENDER_TILE_SIZE : renderer->width - tile->x;
+			tile->height = tile->y + RENDER_TILE_SIZE <= renderer->height ? RENDER_TILE_SIZE : renderer->height - tile->y;
+			tile->cost = 0;
+			tile->rays = 0;
+			tile->skipped = 0;
+			tile->priority = 0;
+			tile->done = 0;
+			tile->worker = 0;
+			tile->reported = 0;
+			tile->stats = render_stats_zero();
+			tile->reflections = 0;
+			tile->reflection_time = 0;
+			renderer->tile_order[j * columns + i] = tile;
+		}
+	}
+}
+
+// Works out the traced size and camera from the target size, the scale and
+// the camera as given.
+static void renderer_update_view(Renderer* renderer) {
+	const int width = renderer->width;
+	const int height = renderer->height;
+	FPType scale = renderer->settings.scale;
+	if (!(scale > (FPType)0) || scale > (FPType)1) { scale = (FPType)1; }
+	renderer->width = (int)floor(renderer->output_width * scale + (FPType)0.5);
+	renderer->height = (int)floor(renderer->output_height * scale + (FPType)0.5);
+	if (renderer->width < 1) { renderer->width = 1; }
+	if (renderer->height < 1) { renderer->height = 1; }
+	renderer->camera = renderer->view;
+	renderer->camera.screen_depth *= (FPType)renderer->height / (FPType)renderer->output_height;
+	if (renderer->width != width || renderer->height != height) {
+		renderer_update_tiles(renderer);
+	}
+}
+
+Renderer* renderer_new(int width, int height) {
+	Renderer* renderer = malloc(sizeof(Renderer));
+	renderer->output_width = width;
+	renderer->output_height = height;
+	renderer->width = 0;
+	renderer->height = 0;
+	renderer->scene = 0;
+	renderer->view = camera_init();
+	renderer->camera_rays = camera_rays_new();
+	renderer->settings = render_settings_default();
+	renderer->light_dir = (Vec3){1,1,1};
+	renderer->light_dir = vec3_normalize(&renderer->light_dir);
+	renderer->shadow_cache = shadow_cache_new();
+	renderer->light_grid = light_grid_new();
+	renderer->ambient_cache = ambient_cache_new();
+	renderer->lights = 0;
+	renderer->tile_done_fn = 0;
+	renderer->tile_done_data = 0;
+	renderer->tiles_final = 0;
+	renderer->cancelled = 0;
+	renderer->workers = workers_new(workers_cpu_count());
+	const int worker_count = workers_count(renderer->workers);
+	renderer->reflection_buffers = malloc(sizeof(RenderReflectionBuffer) * worker_count);
+	for (int i = 0; i < worker_count; ++i) {
+		RenderReflectionBuffer* buffer = &renderer->reflection_buffers[i];
+		const int size = RENDER_TILE_SIZE * RENDER_TILE_SIZE;
+		buffer->reflections = malloc(sizeof(RenderReflection) * size);
+		buffer->count = 0;
+		buffer->order = malloc(sizeof(int) * size);
+		buffer->keys = malloc(sizeof(unsigned int) * size);
+		buffer->scratch_order = malloc(sizeof(int) * size);
+		buffer->scratch_keys = malloc(sizeof(unsigned int) * size);
+	}
+	renderer->sort_reflections = 0;
+	renderer->reflection_cost[0] = renderer->reflection_cost[1] = 0;
+	renderer->reflection_runs[0] = renderer->reflection_runs[1] = 0;
+	const int max_tiles = render_tiles_spanning(width) * render_tiles_spanning(height);
+	renderer->tiles = malloc(sizeof(RenderTile) * max_tiles);
+	renderer->tile_order = malloc(sizeof(RenderTile*) * max_tiles);
+	renderer->tile_count = 0;
+	renderer->columns = 0;
+	// Laid out in tiles at the traced size, which never needs more than at
+	// the target size.
+	const int pixels = render_target_size(width, height);
+	renderer->samples = malloc(sizeof(PixelSample) * pixels);
+	renderer->reprojected = malloc(sizeof(PixelSample) * pixels);
+	renderer->edges = malloc(pixels);
+	renderer->scaled = aligned_malloc(sizeof(float) * 4 * pixels);
+	renderer->path_pixels = malloc(sizeof(PathPixel) * pixels);
+	renderer->denoiser = denoiser_new();
+	renderer->denoise_seconds = 0;
+	renderer->frame = 0;
+	renderer_update_view(renderer);
+	renderer_restart(renderer);
+	return renderer;
+}
+
+void renderer_free(Renderer* renderer) {
+	for (int i = 0; i < workers_count(renderer->workers); ++i) {
+		RenderReflectionBuffer* buffer = &renderer->reflection_buffers[i];
+		free(buffer->reflections);
+		free(buffer->order);
+		free(buffer->keys);
+		free(buffer->scratch_order);
+		free(buffer->scratch_keys);
+	}
+	free(renderer->reflection_buffers);
+	workers_free(renderer->workers);
+	camera_rays_free(renderer->camera_rays);
+	shadow_cache_free(renderer->shadow_cache);
+	light_grid_free(renderer->light_grid);
+	ambient_cache_free(renderer->ambient_cache);
+	if (renderer->lights != 0) {
+		light_tree_free(renderer->lights);
+	}
+	free(renderer->tiles);
+	free(renderer->tile_order);
+	free(renderer->samples);
+	free(renderer->reprojected);
+	free(renderer->edges);
+	aligned_free(renderer->scaled);
+	free(renderer->path_pixels);
+	denoiser_free(renderer->denoiser);
+	free(renderer);
+}
+
+void renderer_set_scene(Renderer* renderer, const Scene* scene) {
+	if (renderer->scene == scene) { return; }
+	renderer->scene = scene;
+	renderer_restart(renderer);
+}
+
+void renderer_set_lights(Renderer* renderer, const Light* lights, int count) {
+	if (renderer->lights != 0) {
+		light_tree_free(renderer->lights);
+		renderer->lights = 0;
+	}
+	if (count > 0) {
+		renderer->lights = light_tree_new(lights, count);
+	}
+	renderer_restart(renderer);
+}
+
+static void renderer_begin_frame(Renderer* renderer, RenderStage stage) {
+	if (stage == RenderStage_Trace || stage == RenderStage_PathTrace) {
+		// Tracing overwrites the samples as it goes, and path tracing
+		// leaves them out of date.
+		renderer->history_valid = 0;
+	}
+	// What an abandoned pass traced is still good.
+	ambient_cache_commit(renderer->ambient_cache);
+	shadow_cache_commit(renderer->shadow_cache);
+	if (stage == RenderStage_PathTrace) {
+		memset(renderer->path_pixels, 0, sizeof(PathPixel) * render_target_size(renderer->width, renderer->height));
+		renderer->path_passes = 0;
+		renderer->path_samples = 0;
+		renderer->path_seconds = 0;
+	}
+	renderer->stage = stage;
+	renderer->step = renderer_first_step(renderer);
+	renderer->pass_started = 0;
+	for (int i = 0; i < renderer->tile_count; ++i) {
+		RenderTile* tile = &renderer->tiles[i];
+		if (tile->rays > 0) { tile->cost = tile->rays; }
+		tile->rays = 0;
+	}
+	renderer->stats = render_stats_zero();
+	renderer->stats.pixels = renderer->width * renderer->height;
+	renderer->stats.tiles = renderer->tile_count;
+	++renderer->frame;
+}
+
+void renderer_set_camera(Renderer* renderer, const Camera* camera) {
+	if (memcmp(&renderer->view, camera, sizeof(Camera)) == 0) { return; }
+	renderer->view = *camera;
+	renderer_update_view(renderer);
+	if (renderer->settings.path_trace) {
+		renderer_begin_frame(renderer, RenderStage_PathTrace);
+	} else if (renderer->settings.reproject && renderer->history_valid) {
+		renderer_begin_frame(renderer, RenderStage_Reproject);
+	} else {
+		renderer_begin_frame(renderer, RenderStage_Trace);
+	}
+}
+
+void renderer_set_settings(Renderer* renderer, const RenderSettings* settings) {
+	if (memcmp(&renderer->settings, settings, sizeof(RenderSettings)) == 0) { return; }
+	renderer->settings = *settings;
+	renderer_update_view(renderer);
+	renderer_restart(renderer);
+}
+
+void renderer_set_tile_done(Renderer* renderer, RenderTileDoneFn fn, void* data) {
+	renderer->tile_done_fn = fn;
+	renderer->tile_done_data = data;
+}
+
+void renderer_cancel(Renderer* renderer) {
+	renderer->cancelled = 1;
+}
+
+void renderer_resume(Renderer* renderer) {
+	renderer->cancelled = 0;
+}
+
+void renderer_restart(Renderer* renderer) {
+	renderer_begin_frame(renderer, renderer->settings.path_trace ? RenderStage_PathTrace : RenderStage_Trace);
+}
+
+int renderer_is_complete(const Renderer* renderer) {
+	return renderer->stage == RenderStage_Complete;
+}
+
+RenderStats renderer_stats(const Renderer* renderer) {
+	return renderer->stats;
+}
+
+int renderer_tile_count(const Renderer* renderer) {
+	return renderer->tile_count;
+}
+
+void renderer_tile_rect(const Renderer* renderer, int tile, int* x, int* y, int* width, int* height) {
+	const RenderTile* t = &renderer->tiles[tile];
+	// Scaled edges, so neighbouring tiles still meet.
+	const int x0 = t->x * renderer->output_width / renderer->width;
+	const int y0 = t->y * renderer->output_height / renderer->height;
+	const int x1 = (t->x + t->width) * renderer->output_width / renderer->width;
+	const int y1 = (t->y + t->height) * renderer->output_height / renderer->height;
+	*x = x0;
+	*y = y0;
+	*width = x1 - x0;
+	*height = y1 - y0;
+}
+
+static void renderer_report_tile(Renderer* renderer, RenderTile* tile) {
+	tile->reported = 1;
+	if (renderer->tile_done_fn != 0) {
+		renderer->tile_done_fn(renderer->tile_done_data, tile - renderer->tiles);
+	}
+}
+
+static void render_target_fill(RenderTarget* target, int x, int y, int width, int height, const Colour* colour) {
+	const float red = (float)colour->red;
+	const float green = (float)colour->green;
+	const float blue = (float)colour->blue;
+	for (int j = 0; j < height; ++j) {
+		float* row = target->pixels + render_tile_row_index(target->columns, y + j) * 4;
+		for (int i = 0; i < width; ++i) {
+			float* p = row + render_tile_column_index(x + i) * 4;
+			p[0] = red;
+			p[1] = green;
+			p[2] = blue;
+			p[3] = 1.0f;
+		}
+	}
+}
+
+// Index of a pixel at the traced size in the renderer's per-pixel buffers.
+static inline int renderer_pixel(const Renderer* renderer, int x, int y) {
+	return render_pixel_index(renderer->columns, x, y);
+}
+
+// Seeds the light samples from where the point is, quantised, so a surface
+// gets the same ones every frame and doesn't flicker.
+static unsigned int render_point_seed(const Vec3* point) {
+	unsigned int h = hash_uint((unsigned int)(int)floor(point->x * (FPType)16));
+	h = hash_uint(h ^ (unsigned int)(int)floor(point->y * (FPType)16));
+	return hash_uint(h ^ (unsigned int)(int)floor(point->z * (FPType)16));
+}
+
+// Traces a shadow ray from point towards a light distance away along
+// to_light. Returns non-zero if nothing is in the way.
+static int renderer_light_visible(const Renderer* renderer, const Vec3* point, const Vec3* to_light, FPType distance, RenderStats* stats) {
+	Ray ray = ray_init(point, to_light);
+	Vec3 ro = ray_point(&ray, (FPType)0.1);
+	ray = ray_set_origin(&ray, &ro);
+	++stats->rays;
+	++stats->shadow_rays;
+	FPType time;
+	return !scene_is_ray_blocked(renderer->scene, &ray, distance - (FPType)0.2, &time);
+}
+
+// Adds what the area light gives the surface from the point (u, v) maps to
+// on it to *sum, counting the sample in *visible or *blocked unless the
+// point can't light the surface anyway.
+static void renderer_sample_area_light(const Renderer* renderer, const Light* light, const Vec3* point, const Vec3* normal, FPType u, FPType v, Colour* sum, int* visible, int* blocked, RenderStats* stats) {
+	Vec3 from = light_sample_position(light, u, v);
+	Vec3 to_light;
+	FPType distance;
+	Colour c = light_illuminate_from(light, &from, point, normal, &to_light, &distance);
+	if (c.red + c.green + c.blue <= (FPType)0) { return; }
+	if (!renderer_light_visible(renderer, point, &to_light, distance, stats)) {
+		++*blocked;
+		return;
+	}
+	++*visible;
+	sum->red += c.red;
+	sum->green += c.green;
+	sum->blue += c.blue;
+}
+
+// Irradiance an area light gives a surface, shadows included, averaged over
+// points on it. One point is traced in each cell of a coarse grid over the
+// light, in a random one of the quarters of the cell, so on their own they
+// spread evenly over it. Only if they disagree on whether the light is
+// blocked, so the point is in its penumbra, are the other quarters traced
+// too, making one point in each cell of a grid twice as fine.
+static Colour renderer_trace_area_light(const Renderer* renderer, const Light* light, const Vec3* point, const Vec3* normal, unsigned int seed, RenderStats* stats) {
+	const int coarse = RENDER_AREA_LIGHT_GRID;
+	const int fine = coarse * 2;
+	int picked[RENDER_AREA_LIGHT_GRID * RENDER_AREA_LIGHT_GRID];
+	Colour sum = (Colour){0,0,0};
+	int visible = 0, blocked = 0;
+	for (int k = 0; k < coarse * coarse; ++k) {
+		int quarter = (int)(hash_uint(seed - 1 - k) >> 30);
+		int fx = (k % coarse) * 2 + (quarter & 1);
+		int fy = (k / coarse) * 2 + (quarter >> 1);
+		picked[k] = fy * fine + fx;
+		unsigned int h = hash_uint(seed + picked[k]);
+		FPType u = ((FPType)fx + hash_unit(h)) / (FPType)fine;
+		FPType v = ((FPType)fy + hash_unit(hash_uint(h))) / (FPType)fine;
+		renderer_sample_area_light(renderer, light, point, normal, u, v, &sum, &visible, &blocked, stats);
+	}
+	int count = coarse * coarse;
+	if (!renderer->settings.adaptive_penumbra || (visible > 0 && blocked > 0)) {
+		for (int cell = 0; cell < fine * fine; ++cell) {
+			int fx = cell % fine, fy = cell / fine;
+			if (picked[(fy / 2) * coarse + fx / 2] == cell) { continue; }
+			unsigned int h = hash_uint(seed + cell);
+			FPType u = ((FPType)fx + hash_unit(h)) / (FPType)fine;
+			FPType v = ((FPType)fy + hash_unit(hash_uint(h))) / (FPType)fine;
+			renderer_sample_area_light(renderer, light, point, normal, u, v, &sum, &visible, &blocked, stats);
+		}
+		count = fine * fine;
+	}
+	FPType scale = (FPType)1 / (FPType)count;
+	return (Colour){sum.red * scale, sum.green * scale, sum.blue * scale};
+}
+
+// Estimates the irradiance the point, spot and area lights give a surface
+// by tracing shadow rays to light_samples of them. Each is weighted by the
+// inverse of the chance it was picked, so on average the estimate is the
+// sum over every light. seed picks the lights and where on them.
+static Colour renderer_trace_lights(const Renderer* renderer, const Vec3* point, const Vec3* normal, unsigned int seed, RenderStats* stats) {
+	Colour sum = (Colour){0,0,0};
+	const int samples = renderer->settings.light_samples;
+	if (renderer->lights == 0 || samples <= 0) { return sum; }
+	for (int i = 0; i < samples; ++i) {
+		// One in each of samples equal parts of [0, 1), which spreads them
+		// over the lights better than picking independently.
+		FPType u = ((FPType)i + hash_unit(hash_uint(seed + i))) / (FPType)samples;
+		FPType probability;
+		const Light* light = light_tree_sample(renderer->lights, point, normal, u, &probability);
+		// Nothing this sample reaches can light the point, which counts as a
+		// zero sample. Other samples may still find a light.
+		if (light == 0) { continue; }
+		Colour c;
+		if (light_is_area(light)) {
+			c = renderer_trace_area_light(renderer, light, point, normal, hash_uint(seed + i), stats);
+		} else {
+			Vec3 to_light;
+			FPType distance;
+			c = light_illuminate(light, point, normal, &to_light, &distance);
+			if (c.red + c.green + c.blue <= (FPType)0) { continue; }
+			if (!renderer_light_visible(renderer, point, &to_light, distance, stats)) { continue; }
+		}
+		FPType weight = (FPType)1 / (probability * (FPType)samples);
+		sum.red += c.red * weight;
+		sum.green += c.green * weight;
+		sum.blue += c.blue * weight;
+	}
+	return sum;
+}
+
+// Fraction of the ambient light that reaches a surface, which is less the
+// more of the hemisphere above it nearby surfaces block.
+static FPType renderer_ambient(const Renderer* renderer, const Vec3* point, const Vec3* normal, RenderStats* stats) {
+	const int samples = renderer->settings.ambient_samples;
+	if (samples <= 0) { return 1; }
+	// Hashed again so its rays aren't picked in step with the lights.
+	const unsigned int seed = hash_uint(render_point_seed(point));
+	if (renderer->settings.ambient_cache) {
+		return ambient_cache_query(renderer->ambient_cache, point, normal, seed, &stats->rays, &stats->ambient_cached);
+	}
+	FPType radius;
+	stats->rays += samples;
+	return ambient_occlusion(renderer->scene, point, normal, samples, seed, &radius);
+}
+
+// Whether the directional light is blocked from point, from the shadow cache
+// if it knows.
+static int renderer_sun_shadowed(const Renderer* renderer, const Vec3* point, RenderStats* stats) {
+	const Vec3* light_dir = &renderer->light_dir;
+	ShadowCacheResult shadow = ShadowCache_Unknown;
+	if (renderer->settings.shadow_cache) {
+		int rays = 0;
+		shadow = shadow_cache_query(renderer->shadow_cache, point, &rays);
+		stats->rays += rays;
+		stats->shadow_rays += rays;
+	}
+	if (shadow != ShadowCache_Unknown) {
+		++stats->shadows_cached;
+		return shadow == ShadowCache_Shadowed;
+	}
+	Ray shadow_ray = ray_init(point, light_dir);
+	Vec3 ro = ray_point(&shadow_ray, (FPType)0.1);
+	int shadowed;
+	if (renderer->settings.light_grid) {
+		shadowed = light_grid_is_shadowed(renderer->light_grid, &ro);
+	} else {
+		shadow_ray = ray_set_origin(&shadow_ray, &ro);
+		shadowed = collision_ray_scene(&shadow_ray, renderer->scene).type == Enter;
+	}
+	++stats->rays;
+	++stats->shadow_rays;
+	return shadowed;
+}
+
+// Lights the surface ray entered at cr, leaving out what it reflects.
+static Colour renderer_shade_surface(const Renderer* renderer, const Ray* ray, const CollisionResult* cr, RenderStats* stats) {
+	const Vec3* light_dir = &renderer->light_dir;
+	Colour clr = cr->colour;
+	Vec3 point = ray_point(ray, cr->time);
+	const FPType ambient = (FPType)0.3 * renderer_ambient(renderer, &point, &cr->normal, stats);
+	FPType a = vec3_dot(light_dir, &cr->normal);
+	if (a < ambient) { a = ambient; }
+	Colour lit = renderer_trace_lights(renderer, &point, &cr->normal, render_point_seed(&point), stats);
+
+	if (renderer_sun_shadowed(renderer, &point, stats)) {
+		// Shadow
+		a *= 0.8;
+		if (a < ambient) { a = ambient; }
+	}
+
+	if (a < (FPType)0) { a = (FPType)0; }
+	if (a > (FPType)1) { a = (FPType)1; }
+	if (clr.red < (FPType)0) { clr.red = (FPType)0; }
+	if (clr.green < (FPType)0) { clr.green = (FPType)0; }
+	if (clr.blue < (FPType)0) { clr.blue = (FPType)0; }
+	if (clr.red > (FPType)1) { clr.red = (FPType)1; }
+	if (clr.green > (FPType)1) { clr.green = (FPType)1; }
+	if (clr.blue > (FPType)1) { clr.blue = (FPType)1; }
+	clr = (Colour){(a + lit.red) * clr.red, (a + lit.green) * clr.green, (a + lit.blue) * clr.blue};
+
+	return clr;
+}
+
+// Works out whether the reflection at cr is due, setting it up in reflection
+// if it is. surface is the colour it's to be mixed into. pixel is where the
+// pixel is on screen, and subsample which of its samples this is, 0 unless
+// it's antialiased.
+static int renderer_reflection(const Renderer* renderer, const Ray* ray, const CollisionResult* cr, int depth, FPType throughput, const Colour* surface, unsigned int pixel, unsigned int subsample, RenderReflection* reflection) {
+	const FPType reflectiveness = cr->reflectiveness;
+	if (reflectiveness <= (FPType)0.0 || depth >= renderer->settings.max_reflection_depth) { return 0; }
+	const FPType reflected_throughput = throughput * reflectiveness;
+	// Too little to see, so the surface stands in for what it reflects.
+	if (reflected_throughput < (FPType)RENDER_REFLECTION_MIN_THROUGHPUT) { return 0; }
+	Vec3 point = ray_point(ray, cr->time);
+	// Deeper reflections that add little only carry on some of the time,
+	// scaled up when they do so that on average they add what they should.
+	FPType survival = 1;
+	if (depth + 1 >= RENDER_ROULETTE_DEPTH) {
+		survival = fmin(reflected_throughput / (FPType)RENDER_ROULETTE_THROUGHPUT, (FPType)1);
+	}
+	// Keyed on the path rather than where it hit, so neighbouring pixels
+	// that hit near the same point don't all stop or carry on together.
+	FPType u = hash_unit(hash_uint3(pixel, subsample, (unsigned int)depth + 1));
+	Vec3 rd = vec3_reflect(&ray->direction, &cr->normal);
+	reflection->ray = ray_init(&point, &rd);
+	Vec3 ro = ray_point(&reflection->ray, 0.1);
+	reflection->ray = ray_set_origin(&reflection->ray, &ro);
+	reflection->surface = *surface;
+	reflection->reflectiveness = reflectiveness;
+	reflection->throughput = reflected_throughput;
+	reflection->scale = u < survival ? (FPType)1 / survival : (FPType)0;
+	reflection->depth = depth + 1;
+	reflection->pixel = pixel;
+	reflection->subsample = subsample;
+	return 1;
+}
+
+static Colour renderer_trace_reflection(const Renderer* renderer, const RenderReflection* reflection, RenderStats* stats);
+
+// Shades the surface ray entered at cr, following its reflection while it
+// still adds enough to the pixel. depth is how many reflections were followed
+// to get here, and throughput how much of the pixel's colour this surface
+// makes up.
+static Colour renderer_shade(const Renderer* renderer, const Ray* ray, const CollisionResult* cr, int depth, FPType throughput, unsigned int pixel, unsigned int subsample, RenderStats* stats) {
+	Colour clr = renderer_shade_surface(renderer, ray, cr, stats);
+	RenderReflection reflection;
+	if (!renderer_reflection(renderer, ray, cr, depth, throughput, &clr, pixel, subsample, &reflection)) { return clr; }
+	return renderer_trace_reflection(renderer, &reflection, stats);
+}
+
+// Returns the colour of the surface the reflection is from with what it
+// reflects mixed in. Neither is clamped, as a reflection that survived the
+// roulette has to be brighter to make up for the ones that didn't.
+static Colour renderer_trace_reflection(const Renderer* renderer, const RenderReflection* reflection, RenderStats* stats) {
+	Colour reflected = (Colour){0,0,0};
+	if (reflection->scale > (FPType)0) {
+		CollisionResult cr = collision_ray_scene(&reflection->ray, renderer->scene);
+		++stats->rays;
+		++stats->path_segments;
+		if (cr.type == None) {
+			const FPType background = (FPType)RENDER_BACKGROUND * reflection->scale;
+			reflected = (Colour){background, background, background};
+		} else if (cr.type == Enter) {
+			reflected = renderer_shade(renderer, &reflection->ray, &cr, reflection->depth, reflection->throughput,
+				reflection->pixel, reflection->subsample, stats);
+			reflected = (Colour){reflected.red * reflection->scale, reflected.green * reflection->scale, reflected.blue * reflection->scale};
+		}
+	}
+	return colour_mix(&reflection->surface, &reflected, reflection->reflectiveness);
+}
+
+// Traces a primary ray and fills in sample, with the colour of the surface
+// alone. Returns whether its reflection is due, setting it up in reflection.
+static int renderer_trace_surface(const Renderer* renderer, const Ray* ray, PixelSample* sample, unsigned int pixel, unsigned int subsample, RenderReflection* reflection, RenderStats* stats) {
+	CollisionResult cr = collision_ray_scene(ray, renderer->scene);
+	++stats->rays;
+	++stats->paths;
+	++stats->path_segments;
+	if (cr.type != Enter) {
+		const FPType background = cr.type == None ? (FPType)RENDER_BACKGROUND : (FPType)0;
+		*sample = (PixelSample){(Colour){background, background, background}, INFINITY, 0, ray->direction, 0, 0};
+		return 0;
+	}
+	sample->depth = cr.time;
+	sample->primitive = cr.primitive;
+	sample->point = ray_point(ray, cr.time);
+	sample->view_dependent = cr.reflectiveness > (FPType)0.0;
+	sample->interpolated = 0;
+	sample->colour = renderer_shade_surface(renderer, ray, &cr, stats);
+	return renderer_reflection(renderer, ray, &cr, 0, 1, &sample->colour, pixel, subsample, reflection);
+}
+
+static Colour renderer_trace(const Renderer* renderer, const Ray* primary_ray, PixelSample* sample, unsigned int pixel, unsigned int subsample, RenderStats* stats) {
+	RenderReflection reflection;
+	if (renderer_trace_surface(renderer, primary_ray, sample, pixel, subsample, &reflection, stats)) {
+		sample->colour = renderer_trace_reflection(renderer, &reflection, stats);
+	}
+	return sample->colour;
+}
+
+// As renderer_trace(), except that if deferred isn't 0 the first reflection
+// is added to it to be traced later by renderer_trace_deferred(), and the
+// colour returned is the surface's alone. x, y, width and height are the
+// block of the target the pixel fills.
+static Colour renderer_trace_deferring(const Renderer* renderer, const Ray* primary_ray, PixelSample* sample, RenderReflectionBuffer* deferred, int x, int y, int width, int height, RenderStats* stats) {
+	const unsigned int pixel = (unsigned int)(y * renderer->width + x);
+	if (deferred == 0) { return renderer_trace(renderer, primary_ray, sample, pixel, 0, stats); }
+	RenderReflection* reflection = &deferred->reflections[deferred->count];
+	if (renderer_trace_surface(renderer, primary_ray, sample, pixel, 0, reflection, stats)) {
+		reflection->sample = sample;
+		reflection->x = x;
+		reflection->y = y;
+		reflection->width = width;
+		reflection->height = height;
+		++deferred->count;
+	}
+	return sample->colour;
+}
+
+// Spreads the low 9 bits of v out to every third bit.
+static unsigned int render_morton_spread(unsigned int v) {
+	v &= 0x1ff;
+	v = (v | (v << 16)) & 0x030000ff;
+	v = (v | (v << 8)) & 0x0300f00f;
+	v = (v | (v << 4)) & 0x030c30c3;
+	v = (v | (v << 2)) & 0x09249249;
+	return v;
+}
+
+// Orders the deferred reflections by the octant of their direction, then by
+// their origin along a Morton curve through the bounds of them all. A radix
+// sort on the keys, a byte at a time.
+static void render_sort_reflections(RenderReflectionBuffer* buffer) {
+	const int count = buffer->count;
+	Bounds bounds = bounds_empty();
+	for (int i = 0; i < count; ++i) {
+		const Vec3* o = &buffer->reflections[i].ray.origin;
+		Bounds b = bounds_init(o, o);
+		bounds = bounds_union(&bounds, &b);
+	}
+	Vec3 size = vec3_sub(&bounds.max, &bounds.min);
+	const FPType cells = (FPType)511;
+	Vec3 scale = (Vec3){
+		size.x > (FPType)0 ? cells / size.x : (FPType)0,
+		size.y > (FPType)0 ? cells / size.y : (FPType)0,
+		size.z > (FPType)0 ? cells / size.z : (FPType)0
+	};
+	unsigned int* keys = buffer->keys;
+	int* order = buffer->order;
+	for (int i = 0; i < count; ++i) {
+		const Ray* ray = &buffer->reflections[i].ray;
+		unsigned int x = (unsigned int)((ray->origin.x - bounds.min.x) * scale.x);
+		unsigned int y = (unsigned int)((ray->origin.y - bounds.min.y) * scale.y);
+		unsigned int z = (unsigned int)((ray->origin.z - bounds.min.z) * scale.z);
+		keys[i] = ((unsigned int)ray->octant << 27) | render_morton_spread(x) | (render_morton_spread(y) << 1) | (render_morton_spread(z) << 2);
+		order[i] = i;
+	}
+	unsigned int* scratch_keys = buffer->scratch_keys;
+	int* scratch_order = buffer->scratch_order;
+	for (int shift = 0; shift < 32; shift += 8) {
+		int offsets[257];
+		memset(offsets, 0, sizeof(offsets));
+		for (int i = 0; i < count; ++i) {
+			++offsets[((keys[i] >> shift) & 0xff) + 1];
+		}
+		// Nothing to do if every key has the same byte here.
+		int same = 0;
+		for (int d = 1; d <= 256 && !same; ++d) {
+			same = offsets[d] == count;
+		}
+		if (same) { continue; }
+		for (int d = 1; d <= 256; ++d) {
+			offsets[d] += offsets[d - 1];
+		}
+		for (int i = 0; i < count; ++i) {
+			int j = offsets[(keys[i] >> shift) & 0xff]++;
+			scratch_keys[j] = keys[i];
+			scratch_order[j] = order[i];
+		}
+		unsigned int* tmp_keys = keys;
+		keys = scratch_keys;
+		scratch_keys = tmp_keys;
+		int* tmp_order = order;
+		order = scratch_order;
+		scratch_order = tmp_order;
+	}
+	if (order != buffer->order) {
+		memcpy(buffer->order, order, sizeof(int) * count);
+	}
+}
+
+// Traces the reflections a tile deferred, sorted first if the run in progress
+// sorts them, and writes the finished pixels to the target.
+static void renderer_trace_deferred(Renderer* renderer, RenderTile* tile, RenderReflectionBuffer* buffer, RenderTarget* target) {
+	if (buffer == 0 || buffer->count == 0) { return; }
+	// Whether they're sorted depends on timing, so they don't share what
+	// they trace with each other.
+	ambient_cache_local_end(renderer->ambient_cache);
+	const double start = timer_seconds();
+	if (renderer->sort_reflections) {
+		render_sort_reflections(buffer);
+		tile->stats.reflections_sorted += buffer->count;
+	} else {
+		for (int i = 0; i < buffer->count; ++i) {
+			buffer->order[i] = i;
+		}
+	}
+	for (int i = 0; i < buffer->count; ++i) {
+		RenderReflection* reflection = &buffer->reflections[buffer->order[i]];
+		PixelSample* sample = reflection->sample;
+		sample->colour = renderer_trace_reflection(renderer, reflection, &tile->stats);
+		render_target_fill(target, reflection->x, reflection->y, reflection->width, reflection->height, &sample->colour);
+	}
+	tile->reflection_time += timer_seconds() - start;
+	tile->reflections += buffer->count;
+}
+
+// Buffer for the tile's first reflections, or 0 if they're traced as each
+// pixel is shaded.
+static RenderReflectionBuffer* renderer_tile_reflections(Renderer* renderer, const RenderTile* tile) {
+	if (renderer->settings.ray_sort == RenderRaySort_Off) { return 0; }
+	RenderReflectionBuffer* buffer = &renderer->reflection_buffers[tile->worker];
+	buffer->count = 0;
+	return buffer;
+}
+
+static int render_tile_compare(const void* a, const void* b) {
+	FPType pa = (*(RenderTile* const*)a)->priority;
+	FPType pb = (*(RenderTile* const*)b)->priority;
+	return pa < pb ? -1 : (pa > pb ? 1 : 0);
+}
+
+static void renderer_order_tiles(Renderer* renderer) {
+	const FPType cx = (FPType)0.5 * (FPType)renderer->width;
+	const FPType cy = (FPType)0.5 * (FPType)renderer->height;
+	const FPType max_distance = sqrt(cx*cx + cy*cy) + (FPType)1;
+	for (int i = 0; i < renderer->tile_count; ++i) {
+		RenderTile* tile = &renderer->tiles[i];
+		FPType dx = (FPType)tile->x + (FPType)0.5 * (FPType)tile->width - cx;
+		FPType dy = (FPType)tile->y + (FPType)0.5 * (FPType)tile->height - cy;
+		FPType distance = sqrt(dx*dx + dy*dy) / max_distance;
+		if (renderer->settings.tile_order == RenderTileOrder_Cost) {
+			// Distance, under 1, only breaks ties between whole ray counts.
+			tile->priority = -(FPType)tile->cost * (FPType)(1 + tile->skipped) + distance;
+		} else {
+			tile->priority = distance / (FPType)(1 + tile->skipped);
+		}
+	}
+	qsort(renderer->tile_order, renderer->tile_count, sizeof(RenderTile*), render_tile_compare);
+}
+
+static void render_tile_worker(void* data, int worker) {
+	RenderTileRun* run = data;
+	Renderer* renderer = run->renderer;
+	int traced = 0;
+	while (renderer->stop == RenderPass_Finished) {
+		if (renderer->cancelled) {
+			renderer->stop = RenderPass_Interrupted;
+			break;
+		}
+		// Every worker does at least one tile, so a frame always makes some
+		// progress however short the deadline.
+		if (traced > 0 && run->deadline != 0 && SDL_GetTicks() >= run->deadline) {
+			renderer->stop = RenderPass_Cut;
+			break;
+		}
+		int i = __sync_fetch_and_add(&renderer->next_tile, 1);
+		if (i >= renderer->tile_count) { break; }
+		RenderTile* tile = renderer->tile_order[i];
+		if (tile->done) { continue; }
+		tile->worker = worker;
+		// A tile's pixels are traced in the same order whichever worker
+		// has it, so they can share what they trace straight away.
+		ambient_cache_local_begin(renderer->ambient_cache);
+		run->fn(renderer, tile, run->target);
+		ambient_cache_local_end(renderer->ambient_cache);
+		tile->done = 1;
+		++traced;
+		if (renderer->tiles_final) {
+			renderer_report_tile(renderer, tile);
+		}
+	}
+}
+
+// Whether the next run over the tiles sorts its deferred reflections.
+static int renderer_choose_ray_sort(const Renderer* renderer) {
+	switch (renderer->settings.ray_sort) {
+	case RenderRaySort_Off:
+		return 0;
+	case RenderRaySort_On:
+		return 1;
+	default:
+		break;
+	}
+	// Each way is timed a few times before settling on the faster, which is
+	// still checked now and then as the view may change which it is.
+	const int* runs = renderer->reflection_runs;
+	if (runs[0] < RENDER_RAY_SORT_TRIALS || runs[1] < RENDER_RAY_SORT_TRIALS) { return runs[1] < runs[0]; }
+	const int faster = renderer->reflection_cost[1] < renderer->reflection_cost[0];
+	return (runs[0] + runs[1]) % RENDER_RAY_SORT_PROBE_PERIOD == 0 ? !faster : faster;
+}
+
+FPType renderer_ray_sort_gain(const Renderer* renderer) {
+	if (renderer->reflection_runs[0] == 0 || renderer->reflection_runs[1] == 0) { return 0; }
+	return renderer->reflection_cost[0] / renderer->reflection_cost[1];
+}
+
+// Runs fn over the tiles the pass in progress hasn't done yet, highest
+// priority first, on every worker.
+static RenderPassResult renderer_run_tiles(Renderer* renderer, RenderTileFn fn, RenderTarget* target, Uint32 deadline) {
+	if (!renderer->pass_started) {
+		renderer_order_tiles(renderer);
+		for (int i = 0; i < renderer->tile_count; ++i) {
+			renderer->tiles[i].done = 0;
+		}
+		renderer->pass_started = 1;
+	}
+	RenderTileRun run = (RenderTileRun){renderer, fn, target, deadline};
+	renderer->next_tile = 0;
+	renderer->stop = RenderPass_Finished;
+	renderer->sort_reflections = renderer_choose_ray_sort(renderer);
+	workers_run(renderer->workers, render_tile_worker, &run);
+	int finished = 1;
+	int reflections = 0;
+	double reflection_time = 0;
+	for (int i = 0; i < renderer->tile_count; ++i) {
+		RenderTile* tile = &renderer->tiles[i];
+		render_stats_add(&renderer->stats, &tile->stats);
+		tile->rays += tile->stats.rays;
+		tile->stats = render_stats_zero();
+		reflections += tile->reflections;
+		reflection_time += tile->reflection_time;
+		tile->reflections = 0;
+		tile->reflection_time = 0;
+		if (!tile->done) { finished = 0; }
+	}
+	// Too few to time reliably otherwise.
+	if (reflections >= RENDER_RAY_SORT_MIN_REFLECTIONS) {
+		const int sorted = renderer->sort_reflections;
+		FPType cost = (FPType)(reflection_time / (double)reflections);
+		renderer->reflection_cost[sorted] = renderer->reflection_runs[sorted] == 0 ? cost :
+			renderer->reflection_cost[sorted] * (FPType)0.75 + cost * (FPType)0.25;
+		++renderer->reflection_runs[sorted];
+	}
+	if (finished) {
+		renderer->pass_started = 0;
+		ambient_cache_commit(renderer->ambient_cache);
+		shadow_cache_commit(renderer->shadow_cache);
+		return RenderPass_Finished;
+	}
+	if (renderer->stop == RenderPass_Cut) {
+		renderer->pass_started = 0;
+		ambient_cache_commit(renderer->ambient_cache);
+		shadow_cache_commit(renderer->shadow_cache);
+	}
+	return renderer->stop;
+}
+
+static void renderer_trace_tile(Renderer* renderer, RenderTile* tile, RenderTarget* target) {
+	const int width = renderer->width;
+	const int height = renderer->height;
+	const int step = renderer->step;
+	// Pixels on the grid of the previous pass were traced by it.
+	const int refining = step != renderer_first_step(renderer);
+	RenderReflectionBuffer* deferred = renderer_tile_reflections(renderer, tile);
+	FPType dx[tile->width], dy[tile->width], dz[tile->width];
+	for (int y = tile->y; y < tile->y + tile->height; y += step) {
+		camera_rays_row(renderer->camera_rays, &renderer->camera, tile->x, y, tile->width, dx, dy, dz);
+		const int traced_row = refining && y % (2*step) == 0;
+		const int block_height = y + step <= height ? step : height - y;
+		for (int x = tile->x; x < tile->x + tile->width; x += step) {
+			if (traced_row && x % (2*step) == 0) { continue; }
+			const int i = x - tile->x;
+			Vec3 rd = (Vec3){dx[i], dy[i], dz[i]};
+			Ray ray = ray_init(&renderer->camera.axes.o, &rd);
+			const int block_width = x + step <= width ? step : width - x;
+			Colour colour = renderer_trace_deferring(renderer, &ray, &renderer->samples[renderer_pixel(renderer, x, y)], deferred, x, y, block_width, block_height, &tile->stats);
+			render_target_fill(target, x, y, block_width, block_height, &colour);
+			++tile->stats.samples;
+		}
+	}
+	renderer_trace_deferred(renderer, tile, deferred, target);
+}
+
+// Traces the progressive pass in progress.
+static RenderPassResult renderer_trace_pass(Renderer* renderer, RenderTarget* target) {
+	camera_rays_update(renderer->camera_rays, renderer->width, renderer->height, renderer->camera.screen_depth);
+	return renderer_run_tiles(renderer, renderer_trace_tile, target, 0);
+}
+
+static int render_samples_differ(const PixelSample* a, const PixelSample* b, FPType threshold) {
+	if (a->primitive != b->primitive) { return 1; }
+	if (a->primitive != 0) {
+		FPType depth = a->depth < b->depth ? a->depth : b->depth;
+		if (fabs(a->depth - b->depth) > (FPType)RENDER_ANTIALIAS_DEPTH_THRESHOLD * depth) { return 1; }
+	}
+	return
+		fabs(a->colour.red - b->colour.red) > threshold ||
+		fabs(a->colour.green - b->colour.green) > threshold ||
+		fabs(a->colour.blue - b->colour.blue) > threshold;
+}
+
+// Marks both pixels of every horizontally or vertically adjacent pair whose
+// samples differ.
+static void renderer_find_edges(Renderer* renderer) {
+	const int width = renderer->width;
+	const int height = renderer->height;
+	const FPType threshold = renderer->settings.antialias_threshold;
+	const PixelSample* samples = renderer->samples;
+	unsigned char* edges = renderer->edges;
+	memset(edges, 0, render_target_size(width, height));
+	for (int y = 0; y < height; ++y) {
+		for (int x = 0; x < width; ++x) {
+			const int i = renderer_pixel(renderer, x, y);
+			if (x + 1 < width) {
+				const int right = renderer_pixel(renderer, x + 1, y);
+				if (render_samples_differ(&samples[i], &samples[right], threshold)) {
+					edges[i] = edges[right] = 1;
+				}
+			}
+			if (y + 1 < height) {
+				const int below = renderer_pixel(renderer, x, y + 1);
+				if (render_samples_differ(&samples[i], &samples[below], threshold)) {
+					edges[i] = edges[below] = 1;
+				}
+			}
+		}
+	}
+}
+
+static int renderer_antialias_grid(const Renderer* renderer) {
+	int grid = renderer->settings.antialias_grid;
+	if (grid < 1) { grid = 1; }
+	if (grid > RENDER_ANTIALIAS_MAX_GRID) { grid = RENDER_ANTIALIAS_MAX_GRID; }
+	return grid;
+}
+
+static void renderer_antialias_tile(Renderer* renderer, RenderTile* tile, RenderTarget* target) {
+	const int grid = renderer_antialias_grid(renderer);
+	// Sample offsets at the centre of each stratum, relative to the pixel's
+	// own sample.
+	const FPType stratum = (FPType)1 / (FPType)grid;
+	const FPType scale = (FPType)1 / (FPType)(grid * grid);
+	const int width = tile->width;
+	// Directions of every stratum's ray across the row, one row of them per
+	// stratum.
+	FPType dx[grid * grid][width], dy[grid * grid][width], dz[grid * grid][width];
+	for (int y = tile->y; y < tile->y + tile->height; ++y) {
+		int edges = 0;
+		for (int x = tile->x; x < tile->x + width; ++x) {
+			edges += renderer->edges[renderer_pixel(renderer, x, y)];
+		}
+		if (edges == 0) { continue; }
+		for (int j = 0; j < grid; ++j) {
+			for (int i = 0; i < grid; ++i) {
+				const FPType jx = ((FPType)i + (FPType)0.5) * stratum - (FPType)0.5;
+				const FPType jy = ((FPType)j + (FPType)0.5) * stratum - (FPType)0.5;
+				const int k = j * grid + i;
+				camera_rays_row_jittered(renderer->camera_rays, &renderer->camera, tile->x, y, width, jx, jy, dx[k], dy[k], dz[k]);
+			}
+		}
+		for (int x = tile->x; x < tile->x + width; ++x) {
+			if (!renderer->edges[renderer_pixel(renderer, x, y)]) { continue; }
+			const int c = x - tile->x;
+			Colour sum = (Colour){0,0,0};
+			for (int k = 0; k < grid * grid; ++k) {
+				Vec3 rd = (Vec3){dx[k][c], dy[k][c], dz[k][c]};
+				Ray ray = ray_init(&renderer->camera.axes.o, &rd);
+				PixelSample sample;
+				Colour colour = renderer_trace(renderer, &ray, &sample, y * renderer->width + x, k + 1, &tile->stats);
+				sum.red += colour.red;
+				sum.green += colour.green;
+				sum.blue += colour.blue;
+			}
+			sum = (Colour){sum.red * scale, sum.green * scale, sum.blue * scale};
+			render_target_fill(target, x, y, 1, 1, &sum);
+			tile->stats.samples += grid * grid;
+			++tile->stats.edge_pixels;
+		}
+	}
+}
+
+// Resamples the edge pixels.
+static RenderPassResult renderer_antialias_pass(Renderer* renderer, RenderTarget* target) {
+	if (!renderer->pass_started) {
+		renderer_find_edges(renderer);
+	}
+	return renderer_run_tiles(renderer, renderer_antialias_tile, target, 0);
+}
+
+static RenderRandom render_random_init(int pixel, int sample) {
+	return (RenderRandom){(unsigned int)pixel, (unsigned int)sample, 0, 0};
+}
+
+static void render_random_bounce(RenderRandom* random, int bounce) {
+	random->bounce = (unsigned int)bounce;
+	random->dimension = 0;
+}
+
+static unsigned int render_random_uint(RenderRandom* random) {
+	return hash_uint3(random->pixel, random->sample, random->bounce << 16 | random->dimension++);
+}
+
+// Uniform in [0, 1).
+static FPType render_random_unit(RenderRandom* random) {
+	return hash_unit(render_random_uint(random));
+}
+
+// Light arriving at a diffuse surface straight from the lights, shadows
+// included. Like the rest of the path tracer it's in units of what a white
+// surface facing the directional light reflects, which makes it the
+// irradiance over pi.
+static Colour renderer_path_direct(const Renderer* renderer, const Vec3* point, const Vec3* normal, RenderRandom* random, RenderStats* stats) {
+	Colour direct = renderer_trace_lights(renderer, point, normal, render_random_uint(random), stats);
+	FPType a = vec3_dot(&renderer->light_dir, normal);
+	// Traced exactly, as the shadow cache and light grid answer for a
+	// neighbourhood and what the paths converge to would depend on them.
+	if (a > (FPType)0 && renderer_light_visible(renderer, point, &renderer->light_dir, (FPType)INFINITY, stats)) {
+		direct.red += a;
+		direct.green += a;
+		direct.blue += a;
+	}
+	return direct;
+}
+
+// Follows a path from the camera through diffuse and mirror bounces,
+// returning an estimate of the light it brings back. Surfaces reflect their
+// reflectiveness like a mirror and the rest diffusely in their colour, and
+// each bounce picks one of the two in that proportion. Light from the
+// lights is gathered at every diffuse bounce, and paths that leave the
+// scene off one see an even sky, while those that leave it straight from the
+// camera or off mirrors see the background, as when ray tracing. What the
+// primary ray hit is written to guide.
+static Colour renderer_path_trace(const Renderer* renderer, const Ray* primary_ray, RenderRandom* random, PathGuide* guide, RenderStats* stats) {
+	Colour radiance = (Colour){0,0,0};
+	Colour throughput = (Colour){1,1,1};
+	Ray ray = *primary_ray;
+	++stats->paths;
+	*guide = (PathGuide){(Vec3){0,0,0}, (FPType)PATH_MISS_DEPTH, (Colour){1,1,1}};
+	int diffuse = 0; // whether the last bounce was
+	for (int depth = 0; ; ++depth) {
+		render_random_bounce(random, depth + 1);
+		CollisionResult cr = collision_ray_scene(&ray, renderer->scene);
+		++stats->rays;
+		++stats->path_segments;
+		if (depth == 0 && cr.type != None) {
+			guide->normal = cr.normal;
+			guide->depth = cr.time;
+			guide->albedo = (Colour){
+				fmin(fmax(cr.colour.red, (FPType)0), (FPType)1),
+				fmin(fmax(cr.colour.green, (FPType)0), (FPType)1),
+				fmin(fmax(cr.colour.blue, (FPType)0), (FPType)1)
+			};
+		}
+		if (cr.type == None) {
+			const FPType sky = diffuse ? (FPType)RENDER_PATH_SKY : (FPType)RENDER_BACKGROUND;
+			radiance.red += throughput.red * sky;
+			radiance.green += throughput.green * sky;
+			radiance.blue += throughput.blue * sky;
+			break;
+		}
+		// Inside a solid, which nothing lights.
+		if (cr.type != Enter || depth >= RENDER_PATH_MAX_BOUNCES) { break; }
+		Vec3 point = ray_point(&ray, cr.time);
+		Vec3 rd;
+		diffuse = !(render_random_unit(random) < cr.reflectiveness);
+		if (!diffuse) {
+			rd = vec3_reflect(&ray.direction, &cr.normal);
+		} else {
+			Colour albedo = cr.colour;
+			if (albedo.red < (FPType)0) { albedo.red = (FPType)0; }
+			if (albedo.green < (FPType)0) { albedo.green = (FPType)0; }
+			if (albedo.blue < (FPType)0) { albedo.blue = (FPType)0; }
+			if (albedo.red > (FPType)1) { albedo.red = (FPType)1; }
+			if (albedo.green > (FPType)1) { albedo.green = (FPType)1; }
+			if (albedo.blue > (FPType)1) { albedo.blue = (FPType)1; }
+			throughput = (Colour){throughput.red * albedo.red, throughput.green * albedo.green, throughput.blue * albedo.blue};
+			Colour direct = renderer_path_direct(renderer, &point, &cr.normal, random, stats);
+			radiance.red += throughput.red * direct.red;
+			radiance.green += throughput.green * direct.green;
+			radiance.blue += throughput.blue * direct.blue;
+			// Weighted to the cosine, which cancels with the cosine in
+			// what it brings back so the throughput is just the albedo.
+			// Picking a point on the unit disc and lifting it onto the
+			// hemisphere does that.
+			Vec3 axis = fabs(cr.normal.x) < (FPType)0.5 ? (Vec3){1,0,0} : (Vec3){0,1,0};
+			Vec3 tangent = vec3_cross(&cr.normal, &axis);
+			tangent = vec3_normalize(&tangent);
+			Vec3 bitangent = vec3_cross(&cr.normal, &tangent);
+			FPType u1 = render_random_unit(random);
+			FPType u2 = render_random_unit(random);
+			FPType r = sqrt(u1);
+			FPType phi = (FPType)(2 * M_PI) * u2;
+			Vec3 t = vec3_scale(&tangent, r * cos(phi));
+			Vec3 b = vec3_scale(&bitangent, r * sin(phi));
+			Vec3 n = vec3_scale(&cr.normal, sqrt((FPType)1 - u1));
+			rd = vec3_add(&t, &b);
+			rd = vec3_add(&rd, &n);
+		}
+		// Deeper paths that carry little only carry on some of the time,
+		// scaled up when they do.
+		if (depth + 1 >= RENDER_ROULETTE_DEPTH) {
+			FPType survival = fmin(fmax(throughput.red, fmax(throughput.green, throughput.blue)), (FPType)1);
+			if (!(render_random_unit(random) < survival)) { break; }
+			throughput = (Colour){throughput.red / survival, throughput.green / survival, throughput.blue / survival};
+		}
+		ray = ray_init(&point, &rd);
+		Vec3 ro = ray_point(&ray, (FPType)0.1);
+		ray = ray_set_origin(&ray, &ro);
+	}
+	return radiance;
+}
+
+// Writes the average of what's been path traced of each pixel of the tile
+// to the target.
+static void renderer_show_path_tile(Renderer* renderer, RenderTile* tile, RenderTarget* target) {
+	for (int y = tile->y; y < tile->y + tile->height; ++y) {
+		for (int x = tile->x; x < tile->x + tile->width; ++x) {
+			const PathPixel* pixel = &renderer->path_pixels[renderer_pixel(renderer, x, y)];
+			FPType scale = pixel->count > 0 ? (FPType)1 / (FPType)pixel->count : (FPType)0;
+			Colour colour = (Colour){pixel->sum.red * scale, pixel->sum.green * scale, pixel->sum.blue * scale};
+			render_target_fill(target, x, y, 1, 1, &colour);
+		}
+	}
+}
+
+// Adds a sample to each pixel of the tile, jittered across the pixel.
+static void renderer_path_trace_tile(Renderer* renderer, RenderTile* tile, RenderTarget* target) {
+	for (int y = tile->y; y < tile->y + tile->height; ++y) {
+		for (int x = tile->x; x < tile->x + tile->width; ++x) {
+			PathPixel* pixel = &renderer->path_pixels[renderer_pixel(renderer, x, y)];
+			// Seeded by where the pixel is on screen rather than where it's
+			// stored.
+			RenderRandom random = render_random_init(y * renderer->width + x, pixel->count);
+			FPType sx = (FPType)x - (FPType)0.5 + render_random_unit(&random);
+			FPType sy = (FPType)y - (FPType)0.5 + render_random_unit(&random);
+			Ray ray = camera_rays_ray_jittered(renderer->camera_rays, &renderer->camera, sx, sy);
+			PathGuide guide;
+			Colour colour = renderer_path_trace(renderer, &ray, &random, &guide, &tile->stats);
+			pixel->sum.red += colour.red;
+			pixel->sum.green += colour.green;
+			pixel->sum.blue += colour.blue;
+			pixel->guide.normal = vec3_add(&pixel->guide.normal, &guide.normal);
+			pixel->guide.depth += guide.depth;
+			pixel->guide.albedo.red += guide.albedo.red;
+			pixel->guide.albedo.green += guide.albedo.green;
+			pixel->guide.albedo.blue += guide.albedo.blue;
+			++pixel->count;
+			++tile->stats.samples;
+		}
+	}
+	// Otherwise the whole target is written denoised after the pass.
+	if (!renderer->settings.denoise) {
+		renderer_show_path_tile(renderer, tile, target);
+	}
+}
+
+// Copies row y of the path traced pixels into the denoiser. Its planes are
+// in rows, as it reads them in runs along rows at steps from each pixel.
+static void renderer_denoise_row_in(const Renderer* renderer, DenoiseImage* image, int y) {
+	const FPType min_albedo = (FPType)PATH_MIN_ALBEDO;
+	for (int x = 0; x < renderer->width; ++x) {
+		const int i = y * renderer->width + x;
+		const PathPixel* pixel = &renderer->path_pixels[renderer_pixel(renderer, x, y)];
+		if (pixel->count == 0) {
+			image->red[i] = image->green[i] = image->blue[i] = 0;
+			image->normal_x[i] = image->normal_y[i] = image->normal_z[i] = 0;
+			image->depth[i] = (FPType)PATH_MISS_DEPTH;
+			continue;
+		}
+		// The sums' scale cancels out of the colour over the albedo.
+		const Colour* albedo = &pixel->guide.albedo;
+		image->red[i] = pixel->sum.red / fmax(albedo->red, min_albedo * pixel->count);
+		image->green[i] = pixel->sum.green / fmax(albedo->green, min_albedo * pixel->count);
+		image->blue[i] = pixel->sum.blue / fmax(albedo->blue, min_albedo * pixel->count);
+		Vec3 normal = pixel->guide.normal;
+		FPType length = vec3_length(&normal);
+		if (length > (FPType)0) { normal = vec3_scale(&normal, (FPType)1 / length); }
+		image->normal_x[i] = normal.x;
+		image->normal_y[i] = normal.y;
+		image->normal_z[i] = normal.z;
+		image->depth[i] = pixel->guide.depth / (FPType)pixel->count;
+	}
+}
+
+// Writes row y of the denoised image to the target, with the albedo
+// multiplied back in.
+static void renderer_denoise_row_out(const Renderer* renderer, const DenoiseImage* image, RenderTarget* target, int y) {
+	const FPType min_albedo = (FPType)PATH_MIN_ALBEDO;
+	for (int x = 0; x < renderer->width; ++x) {
+		const int i = y * renderer->width + x;
+		const PathPixel* pixel = &renderer->path_pixels[renderer_pixel(renderer, x, y)];
+		FPType scale = pixel->count > 0 ? (FPType)1 / (FPType)pixel->count : (FPType)0;
+		const Colour* albedo = &pixel->guide.albedo;
+		Colour colour = (Colour){
+			image->red[i] * fmax(albedo->red * scale, min_albedo),
+			image->green[i] * fmax(albedo->green * scale, min_albedo),
+			image->blue[i] * fmax(albedo->blue * scale, min_albedo)
+		};
+		render_target_fill(target, x, y, 1, 1, &colour);
+	}
+}
+
+static void renderer_denoise_copy_worker(void* data, int worker) {
+	RenderDenoiseCopy* copy = data;
+	const int height = copy->renderer->height;
+	for (;;) {
+		int y0 = __sync_fetch_and_add(&copy->next_row, PATH_DENOISE_ROWS);
+		if (y0 >= height) { break; }
+		int y1 = y0 + PATH_DENOISE_ROWS < height ? y0 + PATH_DENOISE_ROWS : height;
+		for (int y = y0; y < y1; ++y) {
+			if (copy->target == 0) {
+				renderer_denoise_row_in(copy->renderer, copy->image, y);
+			} else {
+				renderer_denoise_row_out(copy->renderer, copy->image, copy->target, y);
+			}
+		}
+	}
+}
+
+// Writes the path traced pixels to the target denoised. The filter sees
+// the colour divided by the albedo of what the pixel sees, so it smooths
+// the lighting without blurring texture, which is multiplied back in after.
+// Copying in and out is shared between the workers like the filter is.
+static void renderer_show_path_denoised(Renderer* renderer, RenderTarget* target) {
+	double start = timer_seconds();
+	DenoiseImage* image = denoiser_image(renderer->denoiser, renderer->width, renderer->height);
+	RenderDenoiseCopy copy = (RenderDenoiseCopy){renderer, image, 0, 0};
+	workers_run(renderer->workers, renderer_denoise_copy_worker, &copy);
+	denoiser_run(renderer->denoiser, renderer->workers);
+	copy = (RenderDenoiseCopy){renderer, image, target, 0};
+	workers_run(renderer->workers, renderer_denoise_copy_worker, &copy);
+	renderer->denoise_seconds = timer_seconds() - start;
+}
+
+// Adds a sample to every pixel. Returns RenderPass_Interrupted if only some
+// got one, and those left get it when the pass is resumed.
+static RenderPassResult renderer_path_trace_pass(Renderer* renderer, RenderTarget* target) {
+	const int resumed = renderer->pass_started;
+	const int samples = renderer->stats.samples;
+	camera_rays_update(renderer->camera_rays, renderer->width, renderer->height, renderer->camera.screen_depth);
+	double start = timer_seconds();
+	RenderPassResult result = renderer_run_tiles(renderer, renderer_path_trace_tile, target, 0);
+	renderer->path_seconds += timer_seconds() - start;
+	renderer->path_samples += renderer->stats.samples - samples;
+	if (renderer->settings.denoise) {
+		// A pass that's interrupted is only ever cancelled, and its target
+		// never shown, so it's filtered once it's resumed and finished.
+		if (result != RenderPass_Interrupted) {
+			renderer_show_path_denoised(renderer, target);
+		}
+		return result;
+	}
+	// Each tile this run traced was shown as it finished. Those it didn't
+	// get to are shown with what earlier passes gave them, and a resumed
+	// run also shows the tiles its earlier runs traced, as they were drawn
+	// into whatever target those runs were given.
+	for (int i = 0; i < renderer->tile_count; ++i) {
+		RenderTile* tile = &renderer->tiles[i];
+		if (resumed || !tile->done) {
+			renderer_show_path_tile(renderer, tile, target);
+		}
+	}
+	return result;
+}
+
+FPType renderer_path_samples_per_second(const Renderer* renderer) {
+	return renderer->path_seconds > 0 ? (FPType)(renderer->path_samples / renderer->path_seconds) : (FPType)0;
+}
+
+FPType renderer_denoise_time(const Renderer* renderer) {
+	return (FPType)renderer->denoise_seconds;
+}
+
+static int render_interleave(const RenderSettings* settings) {
+	if (settings->interleave >= 4) { return 4; }
+	if (settings->interleave >= 2) { return 2; }
+	return 1;
+}
+
+// Which of the interleave turns a pixel is traced on.
+static int render_interleave_slot(int interleave, int x, int y) {
+	if (interleave == 2) { return (x + y) & 1; }
+	return ((y & 1) << 1) | (x & 1);
+}
+
+static int render_interleave_frame_slot(int interleave, int frame) {
+	if (interleave == 2) { return frame & 1; }
+	// Diagonally opposite corners of the 2x2 block on consecutive frames,
+	// which flickers less than going round it.
+	static const int order[4] = {0, 3, 1, 2};
+	return order[frame & 3];
+}
+
+// Fills each hole with the average of the traced or reprojected pixels around
+// it. Every 3x3 block has a pixel traced this frame in it, so nothing is left
+// out.
+static void renderer_interpolate_holes(Renderer* renderer, PixelSample* samples, RenderTarget* target) {
+	const int width = renderer->width;
+	const int height = renderer->height;
+	for (int y = 0; y < height; ++y) {
+		for (int x = 0; x < width; ++x) {
+			PixelSample* sample = &samples[renderer_pixel(renderer, x, y)];
+			if (sample->primitive != PIXEL_HOLE) { continue; }
+			Colour sum = (Colour){0,0,0};
+			const PixelSample* nearest = 0;
+			int count = 0;
+			for (int j = y - 1; j <= y + 1; ++j) {
+				for (int i = x - 1; i <= x + 1; ++i) {
+					if (i < 0 || i >= width || j < 0 || j >= height) { continue; }
+					const PixelSample* n = &samples[renderer_pixel(renderer, i, j)];
+					if (n->primitive == PIXEL_HOLE || n->interpolated) { continue; }
+					sum.red += n->colour.red;
+					sum.green += n->colour.green;
+					sum.blue += n->colour.blue;
+					if (nearest == 0 || n->depth < nearest->depth) { nearest = n; }
+					++count;
+				}
+			}
+			if (count == 0) { continue; }
+			FPType scale = (FPType)1 / (FPType)count;
+			*sample = *nearest;
+			sample->colour = (Colour){sum.red * scale, sum.green * scale, sum.blue * scale};
+			sample->interpolated = 1;
+			render_target_fill(target, x, y, 1, 1, &sample->colour);
+			++renderer->stats.interpolated;
+		}
+	}
+}
+
+static void renderer_retrace_tile(Renderer* renderer, RenderTile* tile, RenderTarget* target) {
+	for (int y = tile->y; y < tile->y + tile->height; ++y) {
+		for (int x = tile->x; x < tile->x + tile->width; ++x) {
+			PixelSample* sample = &renderer->samples[renderer_pixel(renderer, x, y)];
+			if (!sample->interpolated) { continue; }
+			Ray ray = camera_rays_ray(renderer->camera_rays, &renderer->camera, x, y);
+			renderer_trace(renderer, &ray, sample, y * renderer->width + x, 0, &tile->stats);
+			render_target_fill(target, x, y, 1, 1, &sample->colour);
+			++tile->stats.samples;
+		}
+	}
+}
+
+// Traces the pixels that were filled in rather than traced.
+static RenderPassResult renderer_retrace_pass(Renderer* renderer, RenderTarget* target) {
+	return renderer_run_tiles(renderer, renderer_retrace_tile, target, 0);
+}
+
+// Traces the pixels of a tile that reprojection didn't cover, or that are due
+// a refresh or their interleave turn.
+static void renderer_reproject_tile(Renderer* renderer, RenderTile* tile, RenderTarget* target) {
+	const Camera* camera = &renderer->camera;
+	PixelSample* current = renderer->reprojected;
+	const int interleave = render_interleave(&renderer->settings);
+	const int refresh = renderer->frame % RENDER_REPROJECT_REFRESH_PERIOD;
+	const int slot = render_interleave_frame_slot(interleave, renderer->frame);
+	RenderReflectionBuffer* deferred = renderer_tile_reflections(renderer, tile);
+	for (int y = tile->y; y < tile->y + tile->height; ++y) {
+		for (int x = tile->x; x < tile->x + tile->width; ++x) {
+			PixelSample* sample = &current[renderer_pixel(renderer, x, y)];
+			int trace;
+			if (interleave > 1) {
+				// Taking turns bounds how stale a pixel gets to interleave
+				// frames, so it replaces the refresh.
+				trace = render_interleave_slot(interleave, x, y) == slot;
+			} else {
+				// Scattered so the refreshed pixels don't form visible lines.
+				int refreshed = (x * 7 + y * 11) % RENDER_REPROJECT_REFRESH_PERIOD == refresh;
+				trace = sample->primitive == PIXEL_HOLE || refreshed;
+			}
+			if (trace) {
+				Ray ray = camera_rays_ray(renderer->camera_rays, camera, x, y);
+				renderer_trace_deferring(renderer, &ray, sample, deferred, x, y, 1, 1, &tile->stats);
+				++tile->stats.samples;
+			} else if (sample->primitive != PIXEL_HOLE) {
+				++tile->stats.reprojected;
+			} else {
+				continue;
+			}
+			render_target_fill(target, x, y, 1, 1, &sample->colour);
+		}
+	}
+	renderer_trace_deferred(renderer, tile, deferred, target);
+}
+
+// Fills a tile the deadline cut off with what was reprojected into it, and
+// the previous frame's pixel wherever nothing was. Those are traced once the
+// camera stops.
+static void renderer_fill_cut_tile(Renderer* renderer, RenderTile* tile, RenderTarget* target) {
+	for (int y = tile->y; y < tile->y + tile->height; ++y) {
+		for (int x = tile->x; x < tile->x + tile->width; ++x) {
+			const int i = renderer_pixel(renderer, x, y);
+			PixelSample* sample = &renderer->reprojected[i];
+			if (sample->primitive == PIXEL_HOLE) {
+				*sample = renderer->samples[i];
+				sample->interpolated = 1;
+				++renderer->stats.interpolated;
+			} else {
+				++renderer->stats.reprojected;
+			}
+			render_target_fill(target, x, y, 1, 1, &sample->colour);
+		}
+	}
+}
+
+// Moves last frame's samples to where they land from the new camera, nearest
+// first, then traces whatever they didn't cover plus this frame's share of
+// refreshed pixels. When interleaving it traces only this frame's share and
+// interpolates whatever is left.
+static RenderPassResult renderer_reproject_pass(Renderer* renderer, RenderTarget* target, Uint32 deadline) {
+	const int width = renderer->width;
+	const int height = renderer->height;
+	const Camera* camera = &renderer->camera;
+	const PixelSample* previous = renderer->samples;
+	PixelSample* current = renderer->reprojected;
+	// Resuming an interrupted pass keeps what its finished tiles traced.
+	if (!renderer->pass_started) {
+		const int pixels = render_target_size(width, height);
+		for (int i = 0; i < pixels; ++i) {
+			current[i].primitive = PIXEL_HOLE;
+		}
+		for (int i = 0; i < width * height; ++i) {
+			const PixelSample* sample = &previous[renderer_pixel(renderer, i % width, i / width)];
+			if (sample->view_dependent || sample->interpolated) { continue; }
+			FPType sx, sy;
+			FPType depth;
+			if (sample->primitive == 0) {
+				if (!camera_direction_to_screen_coord(camera, &sample->point, width, height, &sx, &sy)) { continue; }
+				depth = INFINITY;
+			} else {
+				if (!camera_point_to_screen_coord(camera, &sample->point, width, height, &sx, &sy)) { continue; }
+				Vec3 v = vec3_sub(&sample->point, &camera->axes.o);
+				depth = vec3_length(&v);
+			}
+			int x = (int)floor(sx + (FPType)0.5);
+			int y = (int)floor(sy + (FPType)0.5);
+			if (x < 0 || x >= width || y < 0 || y >= height) { continue; }
+			PixelSample* dst = &current[renderer_pixel(renderer, x, y)];
+			if (dst->primitive == PIXEL_HOLE || depth < dst->depth) {
+				*dst = *sample;
+				dst->depth = depth;
+			}
+		}
+	}
+	camera_rays_update(renderer->camera_rays, width, height, camera->screen_depth);
+	if (renderer_run_tiles(renderer, renderer_reproject_tile, target, deadline) == RenderPass_Interrupted) {
+		return RenderPass_Interrupted;
+	}
+	for (int i = 0; i < renderer->tile_count; ++i) {
+		RenderTile* tile = &renderer->tiles[i];
+		if (tile->done) {
+			tile->skipped = 0;
+		} else {
+			++tile->skipped;
+			++renderer->stats.tiles_cut;
+			renderer_fill_cut_tile(renderer, tile, target);
+		}
+	}
+	if (render_interleave(&renderer->settings) > 1) {
+		renderer_interpolate_holes(renderer, current, target);
+	}
+	renderer->reprojected = renderer->samples;
+	renderer->samples = current;
+	return RenderPass_Finished;
+}
+
+// Bilinear filter from src, which is width x height, to fill dst.
+static void render_target_upscale(RenderTarget* dst, int dst_width, int dst_height, const RenderTarget* src, int width, int height) {
+	// Float offsets within a row of the two source columns each target
+	// column falls between, the weight of the second, and the offset of the
+	// target column within its own row.
+	int x0[dst_width], x1[dst_width], xd[dst_width];
+	float fx[dst_width];
+	for (int x = 0; x < dst_width; ++x) {
+		FPType sx = ((FPType)x + (FPType)0.5) * (FPType)width / (FPType)dst_width - (FPType)0.5;
+		if (sx < (FPType)0) { sx = (FPType)0; }
+		int i = (int)sx;
+		if (i > width - 1) { i = width - 1; }
+		fx[x] = (float)(sx - (FPType)i);
+		x0[x] = render_tile_column_index(i) * 4;
+		x1[x] = render_tile_column_index(i + 1 < width ? i + 1 : i) * 4;
+		xd[x] = render_tile_column_index(x) * 4;
+	}
+	for (int y = 0; y < dst_height; ++y) {
+		FPType sy = ((FPType)y + (FPType)0.5) * (FPType)height / (FPType)dst_height - (FPType)0.5;
+		if (sy < (FPType)0) { sy = (FPType)0; }
+		int j = (int)sy;
+		if (j > height - 1) { j = height - 1; }
+		const float fy = (float)(sy - (FPType)j);
+		const float* r0 = src->pixels + render_tile_row_index(src->columns, j) * 4;
+		const float* r1 = src->pixels + render_tile_row_index(src->columns, j + 1 < height ? j + 1 : j) * 4;
+		float* row = dst->pixels + render_tile_row_index(dst->columns, y) * 4;
+		for (int x = 0; x < dst_width; ++x) {
+			float* p = row + xd[x];
+			for (int c = 0; c < 4; ++c) {
+				float top = r0[x0[x] + c] + (r0[x1[x] + c] - r0[x0[x] + c]) * fx[x];
+				float bottom = r1[x0[x] + c] + (r1[x1[x] + c] - r1[x0[x] + c]) * fx[x];
+				p[c] = top + (bottom - top) * fy;
+			}
+		}
+	}
+}
+
+static RenderStage renderer_after_reproject(const Renderer* renderer) {
+	return renderer->settings.antialias ? RenderStage_Antialias : RenderStage_Complete;
+}
+
+int renderer_render(Renderer* renderer, RenderTarget* output) {
+	if (renderer->stage == RenderStage_Complete) { return 1; }
+	if (renderer->cancelled) { return 0; }
+	// Only here, as the workers query them without locking.
+	if (renderer->settings.light_grid) {
+		light_grid_update(renderer->light_grid, renderer->scene, &renderer->light_dir);
+	}
+	if (renderer->settings.shadow_cache) {
+		shadow_cache_update(renderer->shadow_cache, renderer->scene, &renderer->light_dir,
+			renderer->settings.light_grid ? renderer->light_grid : 0);
+	}
+	if (renderer->settings.ambient_cache) {
+		ambient_cache_update(renderer->ambient_cache, renderer->scene, renderer->settings.ambient_samples);
+	}
+	// Counted from when the frame is asked for rather than when tracing
+	// starts, as that's what the caller is waiting on.
+	const Uint32 deadline = renderer->settings.deadline > (FPType)0 ?
+		SDL_GetTicks() + (Uint32)(renderer->settings.deadline * (FPType)1000 + (FPType)0.5) : 0;
+	const int scaled = renderer->width != renderer->output_width || renderer->height != renderer->output_height;
+	RenderTarget scaled_target = render_target_init(renderer->scaled, renderer->width);
+	RenderTarget* target = scaled ? &scaled_target : output;
+	for (int i = 0; i < renderer->tile_count; ++i) {
+		renderer->tiles[i].reported = 0;
+	}
+	// Otherwise the whole frame is scaled up, filtered or filled in after the
+	// tiles are traced.
+	renderer->tiles_final = !scaled && (renderer->stage == RenderStage_Trace ||
+		renderer->stage == RenderStage_Retrace || renderer->stage == RenderStage_Antialias ||
+		(renderer->stage == RenderStage_Reproject && render_interleave(&renderer->settings) <= 1));
+	switch (renderer->stage) {
+	case RenderStage_Trace:
+		if (renderer_trace_pass(renderer, target) == RenderPass_Interrupted) { break; }
+		renderer->step /= 2;
+		if (renderer->step == 0) {
+			renderer->history_valid = 1;
+			renderer->stage = renderer->settings.antialias ? RenderStage_Antialias : RenderStage_Complete;
+		}
+		break;
+	case RenderStage_Reproject:
+		if (renderer_reproject_pass(renderer, target, deadline) == RenderPass_Interrupted) { break; }
+		renderer->stage = renderer->stats.interpolated > 0 ? RenderStage_Retrace : renderer_after_reproject(renderer);
+		break;
+	case RenderStage_Retrace:
+		if (renderer_retrace_pass(renderer, target) == RenderPass_Interrupted) { break; }
+		renderer->stage = renderer_after_reproject(renderer);
+		break;
+	case RenderStage_Antialias:
+		if (renderer_antialias_pass(renderer, target) == RenderPass_Interrupted) { break; }
+		renderer->stage = RenderStage_Complete;
+		break;
+	case RenderStage_PathTrace:
+		if (renderer_path_trace_pass(renderer, target) == RenderPass_Interrupted) { break; }
+		if (++renderer->path_passes >= RENDER_PATH_MAX_SAMPLES) {
+			renderer->stage = RenderStage_Complete;
+		}
+		break;
+	case RenderStage_Complete:
+		break;
+	}
+	if (scaled) {
+		render_target_upscale(output, renderer->output_width, renderer->output_height, &scaled_target, renderer->width, renderer->height);
+	}
+	// What a cancelled pass left out of the target isn't there to report.
+	if (!renderer->cancelled) {
+		for (int i = 0; i < renderer->tile_count; ++i) {
+			if (!renderer->tiles[i].reported) {
+				renderer_report_tile(renderer, &renderer->tiles[i]);
+			}
+		}
+	}
+	return renderer->stage == RenderStage_Complete;
+}
@@ -0,0 +1,312 @@
+/*
+ * render.h
+ *
+ *  Created on: 19/10/2026
+ *      Author: clinton
+ */
+
+#ifndef RENDER_H_
+#define RENDER_H_
+
+#include "types.h"
+#include "camera.h"
+#include "colour.h"
+#include "scene.h"
+#include "light.h"
+
+// Block size of the first progressive pass. Each later pass halves it until
+// every pixel has been traced.
+#define RENDER_PROGRESSIVE_START_STEP 8
+
+// Frames are traced in square tiles of this size, shared out between the
+// worker threads. A multiple of RENDER_PROGRESSIVE_START_STEP so no
+// progressive block straddles two tiles. Targets and the renderer's own
+// per-pixel buffers are laid out in tiles of the same size, so it must be a
+// power of two no more than 256.
+#define RENDER_TILE_SIZE 32
+
+// Relative difference in depth between neighbouring pixels that counts as
+// an edge when anti-aliasing.
+#define RENDER_ANTIALIAS_DEPTH_THRESHOLD 0.1
+
+#define RENDER_ANTIALIAS_MAX_GRID 4
+
+// When reprojecting, one pixel in this many is re-traced each frame anyway,
+// so every pixel is refreshed at least this often.
+#define RENDER_REPROJECT_REFRESH_PERIOD 16
+
+// A reflection isn't followed once the fraction of the pixel's colour it
+// would make up falls below this.
+#define RENDER_REFLECTION_MIN_THROUGHPUT 0.02
+
+// From this many reflections on, one making up less than
+// RENDER_ROULETTE_THROUGHPUT of the pixel is only followed with a chance in
+// proportion to what it makes up, and weighted up to match.
+#define RENDER_ROULETTE_DEPTH 2
+#define RENDER_ROULETTE_THROUGHPUT 0.25
+
+// With RenderRaySort_Auto, deferred reflections are traced sorted and not
+// this many runs over the tiles each before the faster is settled on, and
+// the slower is tried again every RENDER_RAY_SORT_PROBE_PERIOD runs. Runs
+// with fewer reflections than RENDER_RAY_SORT_MIN_REFLECTIONS aren't timed.
+#define RENDER_RAY_SORT_TRIALS 4
+#define RENDER_RAY_SORT_PROBE_PERIOD 16
+#define RENDER_RAY_SORT_MIN_REFLECTIONS 256
+
+// Area lights are first sampled at one point in each cell of a
+// RENDER_AREA_LIGHT_GRID by RENDER_AREA_LIGHT_GRID grid over them, and in
+// their penumbra at one in each cell of a grid twice as fine.
+#define RENDER_AREA_LIGHT_GRID 2
+
+// How bright what's behind the scene is, wherever a camera ray or the
+// mirror reflection of one leaves it, whether ray or path traced.
+#define RENDER_BACKGROUND 0.0
+
+// When path tracing, paths are cut off after this many bounces, and the
+// frame is complete once every pixel has RENDER_PATH_MAX_SAMPLES samples.
+// Paths that leave the scene off a diffuse bounce bring back a sky this
+// bright, standing in for the ambient light ray tracing adds to surfaces.
+#define RENDER_PATH_MAX_BOUNCES 16
+#define RENDER_PATH_MAX_SAMPLES 1024
+#define RENDER_PATH_SKY 0.3
+
+typedef struct _Renderer Renderer;
+
+// Which tiles are traced first.
+typedef enum {
+	// Nearest the centre of the screen, where the user is looking.
+	RenderTileOrder_Centre,
+	// Most rays traced in it last frame. When reprojecting, these are the
+	// tiles reprojection does worst in.
+	RenderTileOrder_Cost
+}RenderTileOrder;
+
+// How the first reflections of the pixels of a tile are traced.
+typedef enum {
+	// As each pixel is shaded.
+	RenderRaySort_Off,
+	// Once the tile's primary rays are done, sorted by the octant of their
+	// direction then their origin along a Morton curve, so rays near each
+	// other in the scene are traced one after another.
+	RenderRaySort_On,
+	// Deferred, and sorted or not by which has been faster lately.
+	RenderRaySort_Auto
+}RenderRaySort;
+
+// Linear float RGBA pixels the renderer writes into, for tonemap_pack() to
+// turn into something to show or save. Values aren't clamped, so may be
+// over 1 where the light is brighter than white. Pixels are stored a tile at
+// a time rather than a row at a time, see render_pixel_index(), so each
+// worker writes to memory no other is writing to, and pixels near each other
+// on screen are near each other in memory. pixels must be aligned to 16
+// bytes and hold render_target_size() pixels.
+typedef struct {
+	float* pixels;
+	int columns; // of tiles
+}RenderTarget;
+
+typedef struct {
+	// Trace a coarse image first and refine it over successive passes
+	// rather than tracing every pixel in one go.
+	int progressive;
+	// Once a frame is complete, supersample only the pixels that differ from
+	// a neighbour in primitive, depth or colour.
+	int antialias;
+	// Largest difference in any colour channel (0 to 1) between neighbours
+	// that isn't an edge. Lower finds more edges and costs more.
+	FPType antialias_threshold;
+	// Edge pixels are resampled with a grid x grid stratified pattern, up to
+	// RENDER_ANTIALIAS_MAX_GRID.
+	int antialias_grid;
+	// When only the camera changed, build the new frame from the last one's
+	// hits moved into the new view, and only trace the pixels they don't
+	// cover.
+	int reproject;
+	// When reprojecting, trace only one pixel in this many (2 for a
+	// checkerboard, 4 for one per 2x2 block), taking turns from frame to
+	// frame. Others come from the last frame or, where it has nothing,
+	// their neighbours. 1 traces whatever reprojection doesn't cover.
+	int interleave;
+	RenderTileOrder tile_order;
+	// Seconds a reprojected frame may take, or 0 for no limit. Tiles not
+	// started by then keep what was reprojected, and the previous frame's
+	// pixel where nothing was, until the camera stops.
+	FPType deadline;
+	// Fraction of the target's width and height to trace at, upscaled
+	// bilinearly to fill the target. Rounded to whole pixels.
+	FPType scale;
+	// Look shadows up in a cache kept until the scene or light changes,
+	// only tracing shadow rays where it can't tell.
+	int shadow_cache;
+	// Trace shadow rays only against the parts of the scene whose shadow
+	// can fall where they start, found from a grid across the light.
+	int light_grid;
+	// Lights sampled per shading point from the point, spot and area lights,
+	// picked by how much each could light it. Cost stays the same however
+	// many lights there are, at the price of noise. 0 ignores them.
+	int light_samples;
+	// Only trace the finer grid of shadow rays to an area light where the
+	// coarse one is partly blocked, rather than everywhere.
+	int adaptive_penumbra;
+	// Occlusion rays traced over the hemisphere above a shading point to
+	// darken its ambient light by how shut in it is. 0 leaves it unoccluded.
+	int ambient_samples;
+	// Interpolate ambient occlusion from a cache kept until the scene
+	// changes, only tracing it where nothing cached is close enough.
+	int ambient_cache;
+	// Most reflections followed from a pixel.
+	int max_reflection_depth;
+	RenderRaySort ray_sort;
+	// Rather than the above, path trace diffuse and mirror bounces with one
+	// sample per pixel a pass, averaging the passes until the camera, scene
+	// or settings change.
+	int path_trace;
+	// Filter the noise out of path traced frames, guided by the normal,
+	// depth and albedo of what each pixel sees.
+	int denoise;
+}RenderSettings;
+
+typedef struct {
+	int pixels; // traced, which is fewer than the target has when scaled
+	int samples; // primary samples traced so far this frame
+	int rays; // including reflection and shadow rays
+	int edge_pixels;
+	int reprojected; // pixels reused from the previous frame
+	int interpolated; // pixels filled in from neighbours until traced
+	int tiles;
+	int tiles_cut; // by the deadline
+	int shadow_rays; // to every light, including those filling caches
+	int shadows_cached; // shadow rays the shadow cache answered
+	int ambient_cached; // shading points the ambient cache answered
+	int paths; // from the camera
+	int path_segments; // along them, counting the first and each reflection
+	int reflections_sorted; // traced in coherent order
+}RenderStats;
+
+// Called as each tile of a pass is in the target as it will be shown, from
+// whichever thread finished it. tile indexes those of the current traced
+// size.
+typedef void (*RenderTileDoneFn)(void* data, int tile);
+
+static inline RenderSettings render_settings_default() {
+	return (RenderSettings){
+		.progressive = 1,
+		.antialias = 1,
+		.antialias_threshold = 0.1,
+		.antialias_grid = 3,
+		.reproject = 1,
+		.interleave = 1,
+		.tile_order = RenderTileOrder_Centre,
+		.deadline = 0,
+		.scale = 1,
+		.shadow_cache = 1,
+		.light_grid = 1,
+		.light_samples = 4,
+		.adaptive_penumbra = 1,
+		.ambient_samples = 0,
+		.ambient_cache = 1,
+		.max_reflection_depth = 8,
+		.ray_sort = RenderRaySort_Auto,
+		.path_trace = 0,
+		.denoise = 1
+	};
+}
+
+static inline FPType render_stats_samples_per_pixel(const RenderStats* stats) {
+	return stats->pixels == 0 ? (FPType)0 : (FPType)stats->samples / (FPType)stats->pixels;
+}
+
+static inline FPType render_stats_average_path_length(const RenderStats* stats) {
+	return stats->paths == 0 ? (FPType)0 : (FPType)stats->path_segments / (FPType)stats->paths;
+}
+
+// Spreads the low 8 bits of v out to every other bit.
+static inline unsigned int render_tile_spread(unsigned int v) {
+	v &= 0xff;
+	v = (v | (v << 4)) & 0x0f0f;
+	v = (v | (v << 2)) & 0x3333;
+	v = (v | (v << 1)) & 0x5555;
+	return v;
+}
+
+// The index of a pixel is the sum of a part from its column and a part from
+// its row, so a row can be walked by adding the part from each column to the
+// row's. columns is how many tiles across the image is.
+static inline int render_tile_column_index(int x) {
+	const unsigned int u = (unsigned int)x;
+	return (int)((u / RENDER_TILE_SIZE) * RENDER_TILE_SIZE * RENDER_TILE_SIZE + render_tile_spread(u % RENDER_TILE_SIZE));
+}
+
+static inline int render_tile_row_index(int columns, int y) {
+	const unsigned int u = (unsigned int)y;
+	return (int)((u / RENDER_TILE_SIZE) * (unsigned int)columns * RENDER_TILE_SIZE * RENDER_TILE_SIZE + (render_tile_spread(u % RENDER_TILE_SIZE) << 1));
+}
+
+// Tiles are stored one after another in rows, and the pixels of each along a
+// Morton curve, so every 2x2 block, 4x4 block and so on up to the tile is in
+// one piece.
+static inline int render_pixel_index(int columns, int x, int y) {
+	return render_tile_row_index(columns, y) + render_tile_column_index(x);
+}
+
+// Tiles it takes to cover that many pixels in a row or column.
+static inline int render_tiles_spanning(int pixels) {
+	return (pixels + RENDER_TILE_SIZE - 1) / RENDER_TILE_SIZE;
+}
+
+// Pixels in a tiled image of width x height, counting those that pad the
+// tiles on the right and bottom edges out to full size.
+static inline int render_target_size(int width, int height) {
+	return render_tiles_spanning(width) * render_tiles_spanning(height) * RENDER_TILE_SIZE * RENDER_TILE_SIZE;
+}
+
+// For an image width pixels across.
+static inline RenderTarget render_target_init(float* pixels, int width) {
+	return (RenderTarget){pixels, render_tiles_spanning(width)};
+}
+
+// Width and height are those of the targets it will render into.
+Renderer* renderer_new(int width, int height);
+void renderer_free(Renderer* renderer);
+
+// Changing the scene, camera or settings drops whatever work is in progress
+// so the next call to renderer_render() starts on the new frame. Setting them
+// to what they already are does nothing.
+void renderer_set_scene(Renderer* renderer, const Scene* scene);
+// Point, spot and area lights, besides the directional one. Copied.
+void renderer_set_lights(Renderer* renderer, const Light* lights, int count);
+void renderer_set_camera(Renderer* renderer, const Camera* camera);
+void renderer_set_settings(Renderer* renderer, const RenderSettings* settings);
+void renderer_set_tile_done(Renderer* renderer, RenderTileDoneFn fn, void* data);
+void renderer_restart(Renderer* renderer);
+
+// Makes the pass in progress, and any started before renderer_resume(), stop
+// as soon as each worker has finished the tile it's on. Unlike the rest, safe
+// to call from any thread.
+void renderer_cancel(Renderer* renderer);
+void renderer_resume(Renderer* renderer);
+
+// Traces the next pass of the current frame into target. Returns non-zero
+// once the frame is complete at full resolution, after which further calls
+// do nothing until something changes.
+int renderer_render(Renderer* renderer, RenderTarget* target);
+int renderer_is_complete(const Renderer* renderer);
+RenderStats renderer_stats(const Renderer* renderer);
+
+// How many times faster deferred reflections have been traced sorted than
+// not lately, or 0 if they haven't been traced both ways yet.
+FPType renderer_ray_sort_gain(const Renderer* renderer);
+
+// Path traced samples per second since the path tracer last started over,
+// or 0 if it hasn't traced any.
+FPType renderer_path_samples_per_second(const Renderer* renderer);
+
+// Seconds the denoiser last took, or 0 if it hasn't run.
+FPType renderer_denoise_time(const Renderer* renderer);
+
+// Tiles at the current traced size, which changes with the scale. The rect
+// is the part of the target renderer_render() writes that the tile covers.
+int renderer_tile_count(const Renderer* renderer);
+void renderer_tile_rect(const Renderer* renderer, int tile, int* x, int* y, int* width, int* height);
+
+#endif /* RENDER_H_ */
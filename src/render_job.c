@@ -0,0 +1,146 @@
+/*
+ * render_job.c
+ *
+ *  Created on: 19/10/2026
+ *      Author: clinton
+ */
+
+#include <malloc.h>
+#include <memory.h>
+#include <SDL.h>
+#include "render_job.h"
+
+struct _RenderJob {
+	Renderer* renderer;
+	RenderTarget target;
+	RenderJobTileFn tile_fn;
+	void* tile_data;
+	SDL_Thread* thread;
+	// Guards the fields below, and is signalled whenever they change.
+	SDL_mutex* mutex;
+	SDL_cond* changed;
+	int tile_count;
+	unsigned char* tile_ready;
+	int finished;
+	int complete;
+	Uint32 submitted;
+	Uint32 finished_ticks;
+};
+
+static void render_job_tile_done(void* data, int tile) {
+	RenderJob* job = data;
+	// Before the future is ready, so waiting on the tile also waits for
+	// whatever the callback does with it.
+	if (job->tile_fn != 0) {
+		job->tile_fn(job->tile_data, job, tile);
+	}
+	SDL_LockMutex(job->mutex);
+	job->tile_ready[tile] = 1;
+	SDL_CondBroadcast(job->changed);
+	SDL_UnlockMutex(job->mutex);
+}
+
+static int render_job_main(void* data) {
+	RenderJob* job = data;
+	int complete = renderer_render(job->renderer, &job->target);
+	SDL_LockMutex(job->mutex);
+	job->complete = complete;
+	job->finished = 1;
+	job->finished_ticks = SDL_GetTicks();
+	SDL_CondBroadcast(job->changed);
+	SDL_UnlockMutex(job->mutex);
+	return 0;
+}
+
+RenderJob* render_job_submit(Renderer* renderer, const Scene* scene, const Camera* camera, const RenderSettings* settings, RenderTarget* target, RenderJobTileFn tile_fn, void* data) {
+	RenderJob* job = malloc(sizeof(RenderJob));
+	job->renderer = renderer;
+	job->target = *target;
+	job->tile_fn = tile_fn;
+	job->tile_data = data;
+	job->mutex = SDL_CreateMutex();
+	job->changed = SDL_CreateCond();
+	job->finished = 0;
+	job->complete = 0;
+	job->submitted = SDL_GetTicks();
+	job->finished_ticks = 0;
+	renderer_set_settings(renderer, settings);
+	renderer_set_scene(renderer, scene);
+	renderer_set_camera(renderer, camera);
+	// The tiles depend on the scale, so are only known once the settings are.
+	job->tile_count = renderer_tile_count(renderer);
+	job->tile_ready = malloc(job->tile_count);
+	memset(job->tile_ready, 0, job->tile_count);
+	renderer_set_tile_done(renderer, render_job_tile_done, job);
+	renderer_resume(renderer);
+	job->thread = SDL_CreateThread(render_job_main, job);
+	return job;
+}
+
+void render_job_free(RenderJob* job) {
+	render_job_cancel(job);
+	SDL_WaitThread(job->thread, 0);
+	renderer_set_tile_done(job->renderer, 0, 0);
+	SDL_DestroyCond(job->changed);
+	SDL_DestroyMutex(job->mutex);
+	free(job->tile_ready);
+	free(job);
+}
+
+void render_job_cancel(RenderJob* job) {
+	SDL_LockMutex(job->mutex);
+	// Nothing is left to stop once it's finished.
+	if (!job->finished) {
+		renderer_cancel(job->renderer);
+	}
+	SDL_UnlockMutex(job->mutex);
+}
+
+int render_job_is_finished(RenderJob* job) {
+	SDL_LockMutex(job->mutex);
+	int finished = job->finished;
+	SDL_UnlockMutex(job->mutex);
+	return finished;
+}
+
+int render_job_wait(RenderJob* job) {
+	SDL_LockMutex(job->mutex);
+	while (!job->finished) {
+		SDL_CondWait(job->changed, job->mutex);
+	}
+	int complete = job->complete;
+	SDL_UnlockMutex(job->mutex);
+	return complete;
+}
+
+int render_job_tile_count(const RenderJob* job) {
+	return job->tile_count;
+}
+
+int render_job_tile_is_ready(RenderJob* job, int tile) {
+	SDL_LockMutex(job->mutex);
+	int ready = job->tile_ready[tile];
+	SDL_UnlockMutex(job->mutex);
+	return ready;
+}
+
+int render_job_tile_wait(RenderJob* job, int tile) {
+	SDL_LockMutex(job->mutex);
+	while (!job->tile_ready[tile] && !job->finished) {
+		SDL_CondWait(job->changed, job->mutex);
+	}
+	int ready = job->tile_ready[tile];
+	SDL_UnlockMutex(job->mutex);
+	return ready;
+}
+
+void render_job_tile_rect(const RenderJob* job, int tile, int* x, int* y, int* width, int* height) {
+	renderer_tile_rect(job->renderer, tile, x, y, width, height);
+}
+
+FPType render_job_time(RenderJob* job) {
+	SDL_LockMutex(job->mutex);
+	Uint32 end = job->finished ? job->finished_ticks : SDL_GetTicks();
+	SDL_UnlockMutex(job->mutex);
+	return (FPType)(end - job->submitted) / (FPType)1000;
+}
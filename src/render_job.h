@@ -0,0 +1,54 @@
+/*
+ * render_job.h
+ *
+ *  Created on: 19/10/2026
+ *      Author: clinton
+ */
+
+#ifndef RENDER_JOB_H_
+#define RENDER_JOB_H_
+
+#include "render.h"
+
+// One call to renderer_render() run on its own thread, so the caller can keep
+// handling input and cancel it once the frame it's tracing is stale. A
+// renderer may only have one job at a time, and mustn't be used any other way
+// until the job is freed.
+typedef struct _RenderJob RenderJob;
+
+// Called as each tile is in the target as it will be shown, from whichever
+// thread put it there.
+typedef void (*RenderJobTileFn)(void* data, RenderJob* job, int tile);
+
+// Applies whichever of the scene, camera and settings changed, then starts
+// the next pass into target. tile_fn may be 0.
+RenderJob* render_job_submit(Renderer* renderer, const Scene* scene, const Camera* camera, const RenderSettings* settings, RenderTarget* target, RenderJobTileFn tile_fn, void* data);
+
+// Cancels the job if it's still running and waits for it.
+void render_job_free(RenderJob* job);
+
+// Stops the workers once each has finished the tile it's on. Returns
+// straight away, so wait for the job before using what it traced.
+void render_job_cancel(RenderJob* job);
+
+int render_job_is_finished(RenderJob* job);
+
+// Waits for the job to finish. Returns non-zero if the frame is complete,
+// like renderer_render().
+int render_job_wait(RenderJob* job);
+
+// Each tile of the pass is a future that's ready once its rect of the target
+// is as it will be shown. That's as the tile is traced when the pass writes
+// the target directly, and all at once at the end when it's upscaled or
+// filtered into it. Waiting on one returns as soon as it's ready, or the job
+// finished without it, i.e. was cancelled. Returns non-zero if it's ready.
+int render_job_tile_count(const RenderJob* job);
+int render_job_tile_is_ready(RenderJob* job, int tile);
+int render_job_tile_wait(RenderJob* job, int tile);
+// The part of the target the tile covers. Safe while the job runs.
+void render_job_tile_rect(const RenderJob* job, int tile, int* x, int* y, int* width, int* height);
+
+// Seconds from submission until the job finished, or until now if it hasn't.
+FPType render_job_time(RenderJob* job);
+
+#endif /* RENDER_JOB_H_ */
@@ -37,14 +37,67 @@ struct _Scene {
 	RayCollisionFnGLSLCode ray_collision_fn_glsl_code;
 	IsPointInSolidFn is_point_in_solid_fn;
 	IsPointInSolidFnGLSLCode is_point_in_solid_fn_glsl_code;
+	Bounds bounds; // bounds of the surface, i.e. everything a ray can hit
+	Bounds solid_bounds;
+	Bounds complement_bounds;
+	FPType cost; // estimated cost of a ray query, see scene_update_cost()
+	// What was counted while profiling, added up by scene_profile_end().
+	int profile_queries;
+	int profile_visits; // times a parent union found the ray inside our bounds
+	int id;
 	int ref_count;
 };
 
 typedef struct {
 	const Scene* scene1;
 	const Scene* scene2;
+	// The cost model put them the other way round to how they were given.
+	// Ties go to the one given first either way.
+	int swapped;
 }ScenePair;
 
+// Relative costs used by the cost model, in units of a ray-sphere test.
+static const FPType cost_sphere = 1.0;
+static const FPType cost_plane = 0.6;
+static const FPType cost_bounds = 0.4;
+static const FPType cost_from_space = 0.5;
+static const FPType cost_wrapper = 0.1;
+static const FPType cost_checker = 0.6;
+static const FPType cost_union = 0.2;
+
+// Hit probability assumed for finite operands of an unbounded union.
+static const FPType default_hit_probability = 0.5;
+
+// Queries a union needs to have seen before its measured operand visit rates
+// replace the surface area estimates.
+static const int profile_min_queries = 64;
+
+// Counters are only sampled between scene_profile_begin() and
+// scene_profile_end(), which are only called while nothing is tracing, so
+// the workers see the flag change when they're next given work. Every
+// worker queries the scene at once, so rather than share counters each
+// thread counts into a block of its own, indexed by node id, and the blocks
+// are added up at the end.
+typedef struct _SceneProfileBlock {
+	struct _SceneProfileBlock* next;
+	int counts[]; // queries and visits of each node id in turn
+}SceneProfileBlock;
+
+static volatile int profiling = 0;
+// Only nodes made before profiling began are counted.
+static int profile_ids = 0;
+// Started again each time profiling begins, so blocks from before aren't
+// counted into.
+static int profile_generation = 0;
+static SceneProfileBlock* volatile profile_blocks = 0;
+static __thread SceneProfileBlock* thread_profile_block = 0;
+static __thread int thread_profile_generation = 0;
+
+static int next_scene_id = 1;
+
+static void scene_update_cost(Scene* scene);
+static void scene_profile_count(const Scene* scene, int visit);
+
 static void free_data_destructor(void* data) {
 	free(data);
 }
@@ -65,7 +118,8 @@ CollisionResult collision_ray_scene_empty(const Ray* ray, const Scene* scene) {
 		(FPType)0,
 		(Vec3){0,0,0},
 		(Colour){0,0,0},
-		(FPType)0
+		(FPType)0,
+		0
 	};
 }
 
@@ -95,10 +149,25 @@ static Scene* scene_new() {
 	scene->ray_collision_fn_glsl_code = collision_ray_scene_empty_glsl_code;
 	scene->is_point_in_solid_fn = scene_empty_is_point_in_solid;
 	scene->is_point_in_solid_fn_glsl_code = scene_empty_is_point_in_solid_glsl_code;
+	scene->bounds = bounds_empty();
+	scene->solid_bounds = bounds_empty();
+	scene->complement_bounds = bounds_infinite();
+	scene->cost = 0;
+	scene->profile_queries = 0;
+	scene->profile_visits = 0;
+	scene->id = next_scene_id++;
 	scene->ref_count = 1;
 	return scene;
 }
 
+// For a node that hits what base_scene hits but, like scene_new(), has no
+// solid, so a union never culls against it.
+static void scene_copy_bounds(Scene* scene, const Scene* base_scene) {
+	scene->bounds = base_scene->bounds;
+	scene->solid_bounds = bounds_empty();
+	scene->complement_bounds = bounds_infinite();
+}
+
 static void scene_free(Scene* scene) {
 	if (scene->data != 0) {
 		scene->data_destructor_fn(scene->data);
@@ -118,7 +187,11 @@ Scene* scene_empty() {
 }
 
 CollisionResult collision_ray_scene_sphere(const Ray* ray, const Scene* scene) {
-	return collision_ray_sphere(ray, (const Sphere*)scene->data);
+	CollisionResult cr = collision_ray_sphere(ray, (const Sphere*)scene->data);
+	if (cr.type != None) {
+		cr.primitive = scene->id;
+	}
+	return cr;
 }
 
 Text* collision_ray_scene_sphere_glsl_code(const Scene* scene) {
@@ -181,11 +254,18 @@ Scene* scene_sphere(const Sphere* sphere) {
 	scene->ray_collision_fn_glsl_code = collision_ray_scene_sphere_glsl_code;
 	scene->is_point_in_solid_fn = scene_sphere_is_point_in_solid;
 	scene->is_point_in_solid_fn_glsl_code = scene_sphere_is_point_in_solid_glsl_code;
+	scene->bounds = bounds_from_sphere(sphere);
+	scene->solid_bounds = scene->bounds;
+	scene_update_cost(scene);
 	return scene;
 }
 
 CollisionResult collision_ray_scene_plane(const Ray* ray, const Scene* scene) {
-	return collision_ray_plane(ray, (const Plane*)scene->data);
+	CollisionResult cr = collision_ray_plane(ray, (const Plane*)scene->data);
+	if (cr.type != None) {
+		cr.primitive = scene->id;
+	}
+	return cr;
 }
 
 Text* collision_ray_scene_plane_glsl_code(const Scene* scene) {
@@ -218,6 +298,8 @@ Scene* scene_plane(const Plane* plane) {
 	scene->data_destructor_fn = free_data_destructor;
 	scene->ray_collision_fn = collision_ray_scene_plane;
 	scene->ray_collision_fn_glsl_code = collision_ray_scene_plane_glsl_code;
+	scene->bounds = bounds_from_plane(plane);
+	scene_update_cost(scene);
 	return scene;
 }
 
@@ -234,6 +316,10 @@ Scene* scene_half_space(const Plane* plane) {
 	scene->data_destructor_fn = free_data_destructor;
 	scene->ray_collision_fn = collision_ray_scene_plane;
 	scene->is_point_in_solid_fn = scene_half_space_is_point_inside_solid;
+	scene->bounds = bounds_from_plane(plane);
+	scene->solid_bounds = bounds_from_half_space(plane, 0);
+	scene->complement_bounds = bounds_from_half_space(plane, 1);
+	scene_update_cost(scene);
 	return scene;
 }
 
@@ -299,6 +385,10 @@ Scene* scene_from_space(const Scene* scene, const Axes* space) {
 	r->data_destructor_fn = from_space_data_destructor;
 	r->ray_collision_fn = collision_ray_scene_from_space;
 	r->is_point_in_solid_fn = scene_from_space_is_point_in_solid;
+	r->bounds = bounds_from_space(&scene->bounds, space);
+	r->solid_bounds = bounds_from_space(&scene->solid_bounds, space);
+	r->complement_bounds = bounds_from_space(&scene->complement_bounds, space);
+	scene_update_cost(r);
 	return r;
 }
 
@@ -358,48 +448,57 @@ Scene* scene_invert(const Scene* scene) {
 	r->ray_collision_fn_glsl_code = collision_ray_scene_invert_glsl_code;
 	r->is_point_in_solid_fn = scene_invert_is_point_inside_solid;
 	r->is_point_in_solid_fn_glsl_code = scene_invert_is_point_in_solid_fn_glsl_code;
+	r->bounds = scene->bounds;
+	r->solid_bounds = scene->complement_bounds;
+	r->complement_bounds = scene->solid_bounds;
+	scene_update_cost(r);
+	return r;
+}
+
+// First hit on the surface of operand that is not inside other.
+static CollisionResult collision_ray_scene_union_operand(const Ray* ray, const Scene* operand, const Scene* other) {
+	const int max_iterations = 10;
+
+	CollisionResult r;
+	Ray ray2 = *ray;
+	Vec3 p;
+	for (int i = 0; i < max_iterations; ++i) {
+		r = collision_ray_scene(&ray2, operand);
+		if (r.type == None) { break; }
+		p = ray_point(&ray2, r.time);
+		if (!scene_is_point_in_solid(other, &p)) { break; }
+		Vec3 ro = ray_point(&ray2, r.time+0.1);
+		ray2 = ray_set_origin(&ray2, &ro);
+	}
+	if (r.type != None) {
+		Vec3 v = vec3_sub(&p, &ray->origin);
+		r.time = vec3_dot(&ray->direction, &v);
+		if (!ray->unit) {
+			r.time /= vec3_dot(&ray->direction, &ray->direction);
+		}
+	}
 	return r;
 }
 
 CollisionResult collision_ray_scene_union(const Ray* ray, const Scene* scene) {
+	// Operands are kept in the order picked by the cost model, cheapest
+	// expected work first, so the first hit can cull the second operand.
 	const Scene* scene1 = ((ScenePair*)scene->data)->scene1;
 	const Scene* scene2 = ((ScenePair*)scene->data)->scene2;
+	FPType t_near, t_far;
 
-	const int max_iterations = 10;
-
-	CollisionResult r1;
-	{
-		Ray ray2 = *ray;
-		Vec3 p;
-		for (int i = 0; i < max_iterations; ++i) {
-			r1 = collision_ray_scene(&ray2, scene1);
-			if (r1.type == None) { break; }
-			p = ray_point(&ray2, r1.time);
-			if (!scene_is_point_in_solid(scene2, &p)) { break; }
-			Vec3 ro = ray_point(&ray2, r1.time+0.1);
-			ray2 = ray_init(&ro, &ray2.direction);
-		}
-		if (r1.type != None) {
-			Vec3 v = vec3_sub(&p, &ray->origin);
-			r1.time = vec3_dot(&ray->direction, &v);
-		}
+	CollisionResult r1 = (CollisionResult){.type=None};
+	if (bounds_ray_range(&scene1->bounds, ray, &t_near, &t_far)) {
+		if (profiling) { scene_profile_count(scene1, 1); }
+		r1 = collision_ray_scene_union_operand(ray, scene1, scene2);
 	}
 
-	CollisionResult r2;
-	{
-		Ray ray2 = *ray;
-		Vec3 p;
-		for (int i = 0; i < max_iterations; ++i) {
-			r2 = collision_ray_scene(&ray2, scene2);
-			if (r2.type == None) { break; }
-			p = ray_point(&ray2, r2.time);
-			if (!scene_is_point_in_solid(scene1, &p)) { break; }
-			Vec3 ro = ray_point(&ray2, r2.time+0.1);
-			ray2 = ray_init(&ro, &ray2.direction);
-		}
-		if (r2.type != None) {
-			Vec3 v = vec3_sub(&p, &ray->origin);
-			r2.time = vec3_dot(&ray->direction, &v);
+	CollisionResult r2 = (CollisionResult){.type=None};
+	if (bounds_ray_range(&scene2->bounds, ray, &t_near, &t_far)) {
+		if (profiling) { scene_profile_count(scene2, 1); }
+		// Nothing in scene2 can be nearer than r1 if its bounds start past it.
+		if (r1.type == None || t_near <= r1.time) {
+			r2 = collision_ray_scene_union_operand(ray, scene2, scene1);
 		}
 	}
 
@@ -413,7 +512,8 @@ CollisionResult collision_ray_scene_union(const Ray* ray, const Scene* scene) {
 		if (r2.type == None) {
 			return r1;
 		} else {
-			if (r1.time < r2.time) {
+			const int swapped = ((ScenePair*)scene->data)->swapped;
+			if (r1.time < r2.time || (r1.time == r2.time && !swapped)) {
 				return r1;
 			} else {
 				return r2;
@@ -444,11 +544,20 @@ Scene* scene_union(const Scene* scene1, const Scene* scene2) {
 	Scene* r = scene_new();
 	r->type = SceneType_Union;
 	r->data = malloc(sizeof(ScenePair));
-	*((ScenePair*)r->data) = (ScenePair){scene1, scene2};
+	*((ScenePair*)r->data) = (ScenePair){scene1, scene2, 0};
 	r->data_destructor_fn = scene_pair_destructor;
 	r->ray_collision_fn = collision_ray_scene_union;
 	r->is_point_in_solid_fn = scene_union_is_point_in_solid;
 	r->is_point_in_solid_fn_glsl_code = scene_union_is_point_in_solid_glsl_code;
+	r->solid_bounds = bounds_union(&scene1->solid_bounds, &scene2->solid_bounds);
+	r->complement_bounds = bounds_intersect(&scene1->complement_bounds, &scene2->complement_bounds);
+	{
+		// A hit on either operand's surface only counts outside the other.
+		Bounds hits1 = bounds_intersect(&scene1->bounds, &scene2->complement_bounds);
+		Bounds hits2 = bounds_intersect(&scene2->bounds, &scene1->complement_bounds);
+		r->bounds = bounds_union(&hits1, &hits2);
+	}
+	scene_update_cost(r);
 	return r;
 }
 
@@ -496,6 +605,8 @@ Scene* scene_checker(const Scene* scene, FPType size, const Colour* colour1, con
 	*((CheckerData*)r->data) = (CheckerData){scene, size, *colour1, *colour2};
 	r->data_destructor_fn = checker_data_destructor;
 	r->ray_collision_fn = collision_ray_scene_checker;
+	scene_copy_bounds(r, scene);
+	scene_update_cost(r);
 	return r;
 }
 
@@ -524,6 +635,8 @@ Scene* scene_reflective(const Scene* scene, FPType reflectiveness) {
 	*((ReflectiveData*)r->data) = (ReflectiveData){scene, reflectiveness};
 	r->data_destructor_fn = reflective_data_destructor;
 	r->ray_collision_fn = collision_ray_scene_reflective;
+	scene_copy_bounds(r, scene);
+	scene_update_cost(r);
 	return r;
 }
 
@@ -537,14 +650,218 @@ void scene_unref(Scene* scene) {
 	}
 }
 
+static int scene_children(const Scene* scene, const Scene** children) {
+	switch (scene->type) {
+	case SceneType_FromSpace:
+		children[0] = ((FromSpaceData*)scene->data)->scene;
+		return 1;
+	case SceneType_Invert:
+		children[0] = (const Scene*)scene->data;
+		return 1;
+	case SceneType_Union:
+		children[0] = ((ScenePair*)scene->data)->scene1;
+		children[1] = ((ScenePair*)scene->data)->scene2;
+		return 2;
+	case SceneType_Checker:
+		children[0] = ((CheckerData*)scene->data)->scene;
+		return 1;
+	case SceneType_Reflective:
+		children[0] = ((ReflectiveData*)scene->data)->scene;
+		return 1;
+	default:
+		return 0;
+	}
+}
+
+// Expected number of times operand is traced per query of its parent union.
+// Uses the visit rate measured while profiling if there is enough of it,
+// otherwise the chance of a ray through the parent's bounds also passing
+// through the operand's, by the ratio of their surface areas.
+static FPType scene_operand_probability(const Scene* operand, const Scene* parent) {
+	if (parent->profile_queries >= profile_min_queries) {
+		return (FPType)operand->profile_visits / (FPType)parent->profile_queries;
+	}
+	FPType operand_area = bounds_surface_area(&operand->bounds);
+	FPType parent_area = bounds_surface_area(&parent->bounds);
+	if (isinf(operand_area)) { return (FPType)1; }
+	if (parent_area == (FPType)0) { return (FPType)0; }
+	if (isinf(parent_area)) { return default_hit_probability; }
+	return operand_area / parent_area;
+}
+
+// Recomputes the estimated cost of a node from its children's, and for a
+// union swaps its operands so the one with the least expected work is traced
+// first. Union is commutative and ties are broken the same way whichever is
+// first, so this never changes what gets hit.
+static void scene_update_cost(Scene* scene) {
+	const Scene* children[2];
+	scene_children(scene, children);
+	switch (scene->type) {
+	case SceneType_Empty:
+	case SceneType_Box:
+		scene->cost = 0;
+		break;
+	case SceneType_Sphere:
+		scene->cost = cost_sphere;
+		break;
+	case SceneType_Plane:
+	case SceneType_HalfSpace:
+		scene->cost = cost_plane;
+		break;
+	case SceneType_FromSpace:
+		scene->cost = cost_from_space + children[0]->cost;
+		break;
+	case SceneType_Invert:
+	case SceneType_Reflective:
+		scene->cost = cost_wrapper + children[0]->cost;
+		break;
+	case SceneType_Checker:
+		scene->cost = cost_checker + children[0]->cost;
+		break;
+	case SceneType_Union: {
+		ScenePair* pair = (ScenePair*)scene->data;
+		FPType work1 = scene_operand_probability(pair->scene1, scene) * pair->scene1->cost;
+		FPType work2 = scene_operand_probability(pair->scene2, scene) * pair->scene2->cost;
+		if (work2 < work1) {
+			*pair = (ScenePair){pair->scene2, pair->scene1, !pair->swapped};
+		}
+		scene->cost = cost_union + (FPType)2 * cost_bounds + work1 + work2;
+		break;
+	}
+	}
+}
+
+void scene_optimize(Scene* scene) {
+	const Scene* children[2];
+	int count = scene_children(scene, children);
+	for (int i = 0; i < count; ++i) {
+		scene_optimize((Scene*)children[i]);
+	}
+	scene_update_cost(scene);
+}
+
+// Sets the counters of scene and everything under it to the sums of what
+// each thread counted.
+static void scene_profile_add_up(Scene* scene) {
+	const Scene* children[2];
+	int count = scene_children(scene, children);
+	for (int i = 0; i < count; ++i) {
+		scene_profile_add_up((Scene*)children[i]);
+	}
+	scene->profile_queries = 0;
+	scene->profile_visits = 0;
+	if (scene->id >= profile_ids) { return; }
+	for (const SceneProfileBlock* block = profile_blocks; block != 0; block = block->next) {
+		scene->profile_queries += block->counts[scene->id * 2];
+		scene->profile_visits += block->counts[scene->id * 2 + 1];
+	}
+}
+
+static void scene_profile_free_blocks() {
+	while (profile_blocks != 0) {
+		SceneProfileBlock* block = profile_blocks;
+		profile_blocks = block->next;
+		free(block);
+	}
+}
+
+// Counts a query of scene, or a visit if visit is set, in the calling
+// thread's block, which it's given the first time it counts anything.
+static void scene_profile_count(const Scene* scene, int visit) {
+	if (scene->id >= profile_ids) { return; }
+	SceneProfileBlock* block = thread_profile_block;
+	if (thread_profile_generation != profile_generation) {
+		block = calloc(1, sizeof(SceneProfileBlock) + sizeof(int) * 2 * profile_ids);
+		SceneProfileBlock* next;
+		do {
+			next = profile_blocks;
+			block->next = next;
+		} while (__sync_val_compare_and_swap(&profile_blocks, next, block) != next);
+		thread_profile_block = block;
+		thread_profile_generation = profile_generation;
+	}
+	++block->counts[scene->id * 2 + visit];
+}
+
+void scene_profile_begin(Scene* scene) {
+	scene_profile_free_blocks();
+	profile_ids = next_scene_id;
+	++profile_generation;
+	profiling = 1;
+}
+
+void scene_profile_end(Scene* scene) {
+	profiling = 0;
+	scene_profile_add_up(scene);
+	scene_profile_free_blocks();
+	scene_optimize(scene);
+}
+
 CollisionResult collision_ray_scene(const Ray* ray, const Scene* scene) {
+	if (profiling) { scene_profile_count(scene, 0); }
 	return scene->ray_collision_fn(ray, scene);
 }
 
 int scene_is_point_in_solid(const Scene* scene, const Vec3* point) {
+	if (!bounds_contains_point(&scene->solid_bounds, point)) { return 0; }
 	return scene->is_point_in_solid_fn(scene, point);
 }
 
+int scene_is_ray_blocked(const Scene* scene, const Ray* ray, FPType max_time, FPType* time) {
+	FPType t_near, t_far;
+	if (!bounds_ray_range(&scene->bounds, ray, &t_near, &t_far) || t_near > max_time) { return 0; }
+	const Scene* children[2];
+	switch (scene->type) {
+	case SceneType_Union:
+		// From outside, reaching any operand's surface means having
+		// reached the union's, so the part of it inside the other operand
+		// doesn't need to be ruled out.
+	case SceneType_Checker:
+	case SceneType_Reflective: {
+		int count = scene_children(scene, children);
+		for (int i = 0; i < count; ++i) {
+			if (scene_is_ray_blocked(children[i], ray, max_time, time)) { return 1; }
+		}
+		return 0;
+	}
+	default: {
+		CollisionResult r = collision_ray_scene(ray, scene);
+		if (r.type == None || r.time > max_time) { return 0; }
+		*time = r.time;
+		return 1;
+	}
+	}
+}
+
+Bounds scene_bounds(const Scene* scene) {
+	return scene->bounds;
+}
+
+int scene_id(const Scene* scene) {
+	return scene->id;
+}
+
+int scene_union_operands(const Scene* scene, const Scene** operands, int max) {
+	const Scene* children[2];
+	switch (scene->type) {
+	case SceneType_Empty:
+		return 0;
+	case SceneType_Union:
+	case SceneType_Checker:
+	case SceneType_Reflective: {
+		int count = scene_children(scene, children);
+		int r = 0;
+		for (int i = 0; i < count; ++i) {
+			r += scene_union_operands(children[i], operands + r, r < max ? max - r : 0);
+		}
+		return r;
+	}
+	default:
+		if (max > 0) { operands[0] = scene; }
+		return 1;
+	}
+}
+
 Text* collision_ray_scene_glsl_code(const Scene* scene) {
 	const Text* r[] = {
 		text(
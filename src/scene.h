@@ -13,6 +13,7 @@
 #include "sphere.h"
 #include "plane.h"
 #include "box.h"
+#include "bounds.h"
 #include "text.h"
 
 typedef struct _Scene Scene;
@@ -33,9 +34,35 @@ Scene* scene_reflective(const Scene* scene, FPType reflectiveness);
 void scene_ref(Scene* scene);
 void scene_unref(Scene* scene);
 
+// Reorders commutative operands using the cost model, refined by whatever
+// was measured between scene_profile_begin() and scene_profile_end(). None
+// of these are safe while the scene is being traced, as they change the
+// nodes being traced through.
+void scene_optimize(Scene* scene);
+void scene_profile_begin(Scene* scene);
+void scene_profile_end(Scene* scene);
+
 CollisionResult collision_ray_scene(const Ray* ray, const Scene* scene);
 int scene_is_point_in_solid(const Scene* scene, const Vec3* point);
 
+// Whether ray, starting outside every solid, hits anything no further along
+// than max_time. Stops at the first hit it finds rather than looking for
+// the nearest, whose time is written to *time and may be past the nearest.
+int scene_is_ray_blocked(const Scene* scene, const Ray* ray, FPType max_time, FPType* time);
+
+// Everything a ray can hit on the scene's surface.
+Bounds scene_bounds(const Scene* scene);
+
+// Unique to each scene made, so unlike its address it's never reused by a
+// later one. Never 0.
+int scene_id(const Scene* scene);
+
+// Splits scene into the operands of its top level unions, looking through
+// wrappers that only change how a surface is shaded. A ray from outside
+// every solid enters scene if and only if it enters one of them. Returns how
+// many there are, writing at most max of them to operands.
+int scene_union_operands(const Scene* scene, const Scene** operands, int max);
+
 Text* collision_ray_scene_glsl_code(const Scene* scene);
 
 #endif /* SCENE_H_ */
@@ -0,0 +1,278 @@
+/*
+ * shadow_cache.c
+ *
+ *  Created on: 19/10/2026
+ *      Author: clinton
+ */
+
+#include <malloc.h>
+#include <memory.h>
+#include <stdlib.h>
+#include <math.h>
+#include "shadow_cache.h"
+
+#define SHADOW_CACHE_SLOTS (1 << SHADOW_CACHE_SLOT_BITS)
+#define SHADOW_CACHE_PENDING_SLOTS (1 << SHADOW_CACHE_PENDING_BITS)
+
+// Keys pending at most. Half the slots, so probing for a free one ends soon.
+#define SHADOW_CACHE_MAX_PENDING (SHADOW_CACHE_PENDING_SLOTS / 2)
+
+// Slots looked at past the one a key hashes to before giving up.
+#define SHADOW_CACHE_PROBES 16
+
+// A slot's value. Empty means the key was claimed but nothing has been
+// stored yet, and whoever finds it that way works the value out again.
+typedef enum {
+	Slot_Empty = 0,
+	Slot_Lit = ShadowCache_Lit,
+	Slot_Shadowed = ShadowCache_Shadowed,
+	// For a cell, its corners disagree. For a corner, it's inside a solid,
+	// which tells nothing about the surface.
+	Slot_Other
+}SlotValue;
+
+// Cells and their corners share the table, told apart by a bit of the key.
+typedef enum {
+	KeyType_Corner = 0,
+	KeyType_Cell = 1
+}KeyType;
+
+typedef struct {
+	unsigned int key;
+	unsigned char value;
+}ShadowCacheEntry;
+
+struct _ShadowCache {
+	const Scene* scene;
+	int scene_id; // of what it was filled for, as the scene may be freed
+	Vec3 light_dir;
+	const LightGrid* grid;
+	// Open addressed. A key of 0 is a free slot. Only commits change it.
+	unsigned int* keys;
+	unsigned char* values;
+	// Values worked out since the last commit, in a table of their own so
+	// the order they were found in doesn't change where they're committed.
+	volatile unsigned int* pending_keys;
+	volatile unsigned char* pending_values;
+	// Slots of the pending table that were claimed.
+	int* pending_slots;
+	volatile int pending_count;
+	ShadowCacheEntry* entries; // for sorting the pending ones
+};
+
+ShadowCache* shadow_cache_new() {
+	ShadowCache* cache = malloc(sizeof(ShadowCache));
+	cache->scene = 0;
+	cache->scene_id = 0;
+	cache->light_dir = (Vec3){0,0,0};
+	cache->grid = 0;
+	cache->keys = malloc(sizeof(unsigned int) * SHADOW_CACHE_SLOTS);
+	cache->values = malloc(SHADOW_CACHE_SLOTS);
+	memset(cache->keys, 0, sizeof(unsigned int) * SHADOW_CACHE_SLOTS);
+	memset(cache->values, 0, SHADOW_CACHE_SLOTS);
+	cache->pending_keys = malloc(sizeof(unsigned int) * SHADOW_CACHE_PENDING_SLOTS);
+	cache->pending_values = malloc(SHADOW_CACHE_PENDING_SLOTS);
+	memset((void*)cache->pending_keys, 0, sizeof(unsigned int) * SHADOW_CACHE_PENDING_SLOTS);
+	memset((void*)cache->pending_values, 0, SHADOW_CACHE_PENDING_SLOTS);
+	cache->pending_slots = malloc(sizeof(int) * SHADOW_CACHE_PENDING_SLOTS);
+	cache->pending_count = 0;
+	cache->entries = malloc(sizeof(ShadowCacheEntry) * SHADOW_CACHE_MAX_PENDING);
+	return cache;
+}
+
+void shadow_cache_free(ShadowCache* cache) {
+	free(cache->keys);
+	free(cache->values);
+	free((void*)cache->pending_keys);
+	free((void*)cache->pending_values);
+	free(cache->pending_slots);
+	free(cache->entries);
+	free(cache);
+}
+
+// Empties the pending table, touching only the slots that were claimed.
+static void shadow_cache_clear_pending(ShadowCache* cache) {
+	int count = cache->pending_count;
+	// More may have been counted than claimed once it was full.
+	if (count > SHADOW_CACHE_PENDING_SLOTS) { count = SHADOW_CACHE_PENDING_SLOTS; }
+	for (int i = 0; i < count; ++i) {
+		cache->pending_keys[cache->pending_slots[i]] = 0;
+		cache->pending_values[cache->pending_slots[i]] = Slot_Empty;
+	}
+	cache->pending_count = 0;
+}
+
+void shadow_cache_update(ShadowCache* cache, const Scene* scene, const Vec3* light_dir, const LightGrid* grid) {
+	// It gives the same answers either way.
+	cache->grid = grid;
+	// The address may be reused by a new scene, but never the id.
+	const int id = scene != 0 ? scene_id(scene) : 0;
+	cache->scene = scene;
+	if (cache->scene_id == id && memcmp(&cache->light_dir, light_dir, sizeof(Vec3)) == 0) { return; }
+	cache->scene_id = id;
+	cache->light_dir = *light_dir;
+	memset(cache->keys, 0, sizeof(unsigned int) * SHADOW_CACHE_SLOTS);
+	memset(cache->values, 0, SHADOW_CACHE_SLOTS);
+	shadow_cache_clear_pending(cache);
+}
+
+// Indices are offset to be positive and packed 10 bits each. The top bit is
+// always set so no key is 0.
+static unsigned int shadow_cache_key(KeyType type, int x, int y, int z) {
+	return 0x80000000u | ((unsigned int)type << 30) |
+		((unsigned int)(x + SHADOW_CACHE_EXTENT) << 20) |
+		((unsigned int)(y + SHADOW_CACHE_EXTENT) << 10) |
+		(unsigned int)(z + SHADOW_CACHE_EXTENT);
+}
+
+// The top bits of the product are the well mixed ones.
+static unsigned int shadow_cache_hash(unsigned int key, int bits) {
+	return (key * 2654435761u) >> (32 - bits);
+}
+
+// Returns the committed slot holding key, or -1 if it isn't there. *room
+// is set to whether there's a free slot it could be committed to.
+static int shadow_cache_find(const ShadowCache* cache, unsigned int key, int* room) {
+	unsigned int i = shadow_cache_hash(key, SHADOW_CACHE_SLOT_BITS);
+	for (int probe = 0; probe < SHADOW_CACHE_PROBES; ++probe) {
+		unsigned int k = cache->keys[i];
+		if (k == key) { return i; }
+		if (k == 0) {
+			*room = 1;
+			return -1;
+		}
+		i = (i + 1) & (SHADOW_CACHE_SLOTS - 1);
+	}
+	*room = 0;
+	return -1;
+}
+
+// Returns the pending slot holding key, claiming a free one for it if it
+// isn't there yet, or -1 if too many are pending to add it.
+static int shadow_cache_pending_slot(ShadowCache* cache, unsigned int key) {
+	unsigned int i = shadow_cache_hash(key, SHADOW_CACHE_PENDING_BITS);
+	for (;;) {
+		unsigned int k = cache->pending_keys[i];
+		if (k == 0) {
+			// Only over the limit once more keys than it were wanted, which
+			// doesn't depend on the order they were.
+			if (cache->pending_count > SHADOW_CACHE_MAX_PENDING) { return -1; }
+			// Another thread may claim it first, possibly for the same key.
+			k = __sync_val_compare_and_swap(&cache->pending_keys[i], 0, key);
+			if (k == 0) {
+				int n = __sync_fetch_and_add(&cache->pending_count, 1);
+				if (n < SHADOW_CACHE_PENDING_SLOTS) { cache->pending_slots[n] = i; }
+				return i;
+			}
+		}
+		if (k == key) { return i; }
+		i = (i + 1) & (SHADOW_CACHE_PENDING_SLOTS - 1);
+	}
+}
+
+static SlotValue shadow_cache_corner(ShadowCache* cache, int x, int y, int z, int* rays) {
+	const unsigned int key = shadow_cache_key(KeyType_Corner, x, y, z);
+	int room = 0;
+	int slot = shadow_cache_find(cache, key, &room);
+	if (slot >= 0) { return cache->values[slot]; }
+	int pending = shadow_cache_pending_slot(cache, key);
+	if (pending >= 0 && cache->pending_values[pending] != Slot_Empty) { return cache->pending_values[pending]; }
+	const FPType size = (FPType)SHADOW_CACHE_CELL_SIZE;
+	Vec3 p = (Vec3){x * size, y * size, z * size};
+	SlotValue value;
+	if (scene_is_point_in_solid(cache->scene, &p)) {
+		value = Slot_Other;
+	} else {
+		CollisionType hit;
+		if (cache->grid != 0) {
+			hit = light_grid_shadow_ray(cache->grid, &p);
+		} else {
+			Ray ray = ray_init(&p, &cache->light_dir);
+			hit = collision_ray_scene(&ray, cache->scene).type;
+		}
+		++*rays;
+		// Leaving a solid first means p is inside one that didn't say so,
+		// e.g. under a checkered floor.
+		value = hit == Exit ? Slot_Other : hit == Enter ? Slot_Shadowed : Slot_Lit;
+	}
+	if (pending >= 0) { cache->pending_values[pending] = value; }
+	return value;
+}
+
+ShadowCacheResult shadow_cache_query(ShadowCache* cache, const Vec3* point, int* rays) {
+	if (cache->scene == 0) { return ShadowCache_Unknown; }
+	const FPType size = (FPType)SHADOW_CACHE_CELL_SIZE;
+	FPType fx = floor(point->x / size);
+	FPType fy = floor(point->y / size);
+	FPType fz = floor(point->z / size);
+	// The far corner has to be in range too.
+	const FPType lo = (FPType)-SHADOW_CACHE_EXTENT;
+	const FPType hi = (FPType)(SHADOW_CACHE_EXTENT - 2);
+	if (!(fx >= lo && fx <= hi && fy >= lo && fy <= hi && fz >= lo && fz <= hi)) { return ShadowCache_Unknown; }
+	int x = (int)fx, y = (int)fy, z = (int)fz;
+	const unsigned int key = shadow_cache_key(KeyType_Cell, x, y, z);
+	int room = 0;
+	int slot = shadow_cache_find(cache, key, &room);
+	SlotValue value = slot >= 0 ? cache->values[slot] : Slot_Empty;
+	// A cell that will never be committed is traced instead, so what it
+	// shows doesn't depend on which cells got in first.
+	if (value == Slot_Empty && !room) { return ShadowCache_Unknown; }
+	int pending = -1;
+	if (value == Slot_Empty) {
+		pending = shadow_cache_pending_slot(cache, key);
+		if (pending >= 0) { value = cache->pending_values[pending]; }
+	}
+	if (value == Slot_Empty) {
+		int lit = 0, shadowed = 0;
+		for (int i = 0; i < 8; ++i) {
+			SlotValue corner = shadow_cache_corner(cache, x + (i & 1), y + ((i >> 1) & 1), z + (i >> 2), rays);
+			if (corner == Slot_Lit) { ++lit; }
+			if (corner == Slot_Shadowed) { ++shadowed; }
+		}
+		if (lit > 0 && shadowed == 0) {
+			value = Slot_Lit;
+		} else if (shadowed > 0 && lit == 0) {
+			value = Slot_Shadowed;
+		} else {
+			value = Slot_Other;
+		}
+		if (pending >= 0) { cache->pending_values[pending] = value; }
+	}
+	return value == Slot_Other ? ShadowCache_Unknown : (ShadowCacheResult)value;
+}
+
+static int shadow_cache_entry_compare(const void* a, const void* b) {
+	unsigned int ka = ((const ShadowCacheEntry*)a)->key;
+	unsigned int kb = ((const ShadowCacheEntry*)b)->key;
+	return ka < kb ? -1 : ka > kb ? 1 : 0;
+}
+
+void shadow_cache_commit(ShadowCache* cache) {
+	const int count = cache->pending_count;
+	if (count == 0) { return; }
+	// Which keys made it in before it filled depends on which worker got
+	// there first, so if any didn't, none are kept.
+	if (count <= SHADOW_CACHE_MAX_PENDING) {
+		int entries = 0;
+		for (int i = 0; i < count; ++i) {
+			const int slot = cache->pending_slots[i];
+			if (cache->pending_values[slot] == Slot_Empty) { continue; }
+			cache->entries[entries++] = (ShadowCacheEntry){cache->pending_keys[slot], cache->pending_values[slot]};
+		}
+		// A value only depends on where it is, so sorted they go in the same
+		// slots whatever order the workers found them in.
+		qsort(cache->entries, entries, sizeof(ShadowCacheEntry), shadow_cache_entry_compare);
+		for (int i = 0; i < entries; ++i) {
+			const ShadowCacheEntry* entry = &cache->entries[i];
+			int room;
+			if (shadow_cache_find(cache, entry->key, &room) >= 0 || !room) { continue; }
+			unsigned int slot = shadow_cache_hash(entry->key, SHADOW_CACHE_SLOT_BITS);
+			while (cache->keys[slot] != 0) {
+				slot = (slot + 1) & (SHADOW_CACHE_SLOTS - 1);
+			}
+			cache->keys[slot] = entry->key;
+			cache->values[slot] = entry->value;
+		}
+	}
+	shadow_cache_clear_pending(cache);
+}
@@ -0,0 +1,71 @@
+/*
+ * shadow_cache.h
+ *
+ *  Created on: 19/10/2026
+ *      Author: clinton
+ */
+
+#ifndef SHADOW_CACHE_H_
+#define SHADOW_CACHE_H_
+
+#include "types.h"
+#include "vec3.h"
+#include "scene.h"
+#include "light_grid.h"
+
+// Edge length of a cache cell in scene units, which is also the smallest
+// shadow, or gap in one, the cache is sure to keep.
+#define SHADOW_CACHE_CELL_SIZE 4.0
+
+// Cells are indexed from -SHADOW_CACHE_EXTENT to SHADOW_CACHE_EXTENT - 1 on
+// each axis. Points further out aren't cached.
+#define SHADOW_CACHE_EXTENT 512
+
+// The hash table has 1 << SHADOW_CACHE_SLOT_BITS slots. Once there's no room
+// near where a cell hashes to, points in it are left to the caller.
+#define SHADOW_CACHE_SLOT_BITS 21
+
+// Cells and corners worked out between commits are kept in a table of
+// 1 << SHADOW_CACHE_PENDING_BITS slots. If more than half of it is wanted,
+// none of them are committed.
+#define SHADOW_CACHE_PENDING_BITS 20
+
+// Whether points are in shadow from a directional light, kept in a sparse
+// grid so it outlives the view. Filled lazily: the first point to land in a
+// cell traces shadow rays from the cell's corners, and the cell is only
+// cached as lit or shadowed if every corner outside a solid agrees. Cells
+// the shadow edge passes through are left to the caller.
+//
+// So it's an approximation: a shadow that falls within a cell without
+// reaching any of its corners, from anything thinner than
+// SHADOW_CACHE_CELL_SIZE, is lost, and a gap that small in a shadow is
+// filled in. Leave it off for scenes with detail that fine.
+//
+// Safe to query from several threads at once. Cells worked out by queries
+// are only added to the table by the next commit, in an order of their own,
+// so which cells it holds doesn't depend on how the queries were shared out
+// between threads.
+typedef struct _ShadowCache ShadowCache;
+
+typedef enum {
+	ShadowCache_Unknown, // trace it
+	ShadowCache_Lit,
+	ShadowCache_Shadowed
+}ShadowCacheResult;
+
+ShadowCache* shadow_cache_new();
+void shadow_cache_free(ShadowCache* cache);
+
+// Drops everything cached if the scene or light changed since it was
+// filled. Shadow rays are traced through grid if it isn't 0, which must be
+// built for the same scene and light. Not safe while it's being queried.
+void shadow_cache_update(ShadowCache* cache, const Scene* scene, const Vec3* light_dir, const LightGrid* grid);
+
+// Adds the cells worked out since the last commit to the table. Not safe
+// while it's being queried.
+void shadow_cache_commit(ShadowCache* cache);
+
+// *rays is increased by the shadow rays traced to fill the cache.
+ShadowCacheResult shadow_cache_query(ShadowCache* cache, const Vec3* point, int* rays);
+
+#endif /* SHADOW_CACHE_H_ */
@@ -0,0 +1,154 @@
+/*
+ * tonemap.c
+ *
+ *  Created on: 19/10/2026
+ *      Author: clinton
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#include "tonemap.h"
+
+// Packs one pixel. Rounds to nearest even like the vector conversion, so
+// both give the same bytes.
+static void tonemap_pack_pixel(const float* p, float scale, TonemapOrder order, unsigned char* out) {
+	const int first = order == TonemapOrder_BGRA ? 2 : 0;
+	for (int c = 0; c < 3; ++c) {
+		float v = fminf(fmaxf(p[c] * scale, 0.0f), 255.0f);
+		out[c == 0 ? first : c == 2 ? 2 - first : 1] = (unsigned char)lrintf(v);
+	}
+	out[3] = 255;
+}
+
+#ifdef __SSE2__
+// Packs four pixels into 16 bytes.
+static __m128i tonemap_pack_vector(const float* p0, const float* p1, const float* p2, const float* p3, __m128 scale, int bgra) {
+	const float* src[4] = {p0, p1, p2, p3};
+	const __m128 lo = _mm_setzero_ps();
+	const __m128 hi = _mm_set1_ps(255.0f);
+	// Alpha is scaled like the rest, so it's forced to 255 after.
+	const __m128i alpha = _mm_set1_epi32((int)0xff000000);
+	__m128 p[4];
+	for (int i = 0; i < 4; ++i) {
+		p[i] = _mm_load_ps(src[i]);
+		if (bgra) { p[i] = _mm_shuffle_ps(p[i], p[i], _MM_SHUFFLE(3, 0, 1, 2)); }
+		p[i] = _mm_min_ps(_mm_max_ps(_mm_mul_ps(p[i], scale), lo), hi);
+	}
+	// 32 bit to 16 to 8, each pack taking two vectors to one. The values
+	// are already in range, so the saturation never comes into it.
+	__m128i a = _mm_packs_epi32(_mm_cvtps_epi32(p[0]), _mm_cvtps_epi32(p[1]));
+	__m128i b = _mm_packs_epi32(_mm_cvtps_epi32(p[2]), _mm_cvtps_epi32(p[3]));
+	return _mm_or_si128(_mm_packus_epi16(a, b), alpha);
+}
+#endif
+
+// The float offset of a pixel from the start of its tile, which is its
+// offset in an image one tile across.
+static int tonemap_tile_offset(int x, int y) {
+	return render_pixel_index(1, x, y) * 4;
+}
+
+// Packs columns x0 to x1 of row y of the tile starting at src into dst, the
+// packed row, from column x0.
+static void tonemap_pack_tile_row(const float* src, int x0, int x1, int y, float scale, TonemapOrder order, unsigned char* dst) {
+	for (int x = x0; x < x1; ++x) {
+		tonemap_pack_pixel(src + tonemap_tile_offset(x, y), scale, order, dst + (x - x0) * 4);
+	}
+}
+
+// Packs columns x0 to x1 and rows y0 to y1 of the tile starting at src into
+// dst, from the pixel at (x0, y0), pitch bytes a row.
+static void tonemap_pack_tile(const float* src, int x0, int y0, int x1, int y1, float scale, TonemapOrder order, unsigned char* dst, int pitch) {
+	int y = y0;
+#ifdef __SSE2__
+	const __m128 s = _mm_set1_ps(scale);
+	const int bgra = order == TonemapOrder_BGRA;
+	if (y & 1 && y < y1) {
+		tonemap_pack_tile_row(src, x0, x1, y, scale, order, dst);
+		++y;
+	}
+	for (; y + 2 <= y1; y += 2) {
+		unsigned char* top = dst + (y - y0) * pitch;
+		unsigned char* bottom = top + pitch;
+		int x = x0;
+		for (; x < x1 && x & 3; ++x) {
+			tonemap_pack_pixel(src + tonemap_tile_offset(x, y), scale, order, top + (x - x0) * 4);
+			tonemap_pack_pixel(src + tonemap_tile_offset(x, y + 1), scale, order, bottom + (x - x0) * 4);
+		}
+		// A run of 4 x 2 pixels starting on an even row and a multiple of 4
+		// columns in is 8 pixels in a row in memory, two 2 x 2 blocks side
+		// by side, so it's read in one piece and written as 16 bytes to
+		// each row.
+		for (; x + 4 <= x1; x += 4) {
+			const float* p = src + tonemap_tile_offset(x, y);
+			_mm_storeu_si128((__m128i*)(top + (x - x0) * 4), tonemap_pack_vector(p, p + 4, p + 16, p + 20, s, bgra));
+			_mm_storeu_si128((__m128i*)(bottom + (x - x0) * 4), tonemap_pack_vector(p + 8, p + 12, p + 24, p + 28, s, bgra));
+		}
+		for (; x < x1; ++x) {
+			tonemap_pack_pixel(src + tonemap_tile_offset(x, y), scale, order, top + (x - x0) * 4);
+			tonemap_pack_pixel(src + tonemap_tile_offset(x, y + 1), scale, order, bottom + (x - x0) * 4);
+		}
+	}
+#endif
+	for (; y < y1; ++y) {
+		tonemap_pack_tile_row(src, x0, x1, y, scale, order, dst + (y - y0) * pitch);
+	}
+}
+
+// Packs the width x height pixels of src from (x, y) into dst, from the
+// pixel at (x, y), pitch bytes a row. A tile at a time, so src is read in
+// the order it's stored.
+static void tonemap_pack_area(const RenderTarget* src, int x, int y, int width, int height, float scale, TonemapOrder order, unsigned char* dst, int pitch) {
+	const int x_end = x + width;
+	const int y_end = y + height;
+	for (int ty = y - y % RENDER_TILE_SIZE; ty < y_end; ty += RENDER_TILE_SIZE) {
+		const int y0 = ty > y ? ty : y;
+		const int y1 = ty + RENDER_TILE_SIZE < y_end ? ty + RENDER_TILE_SIZE : y_end;
+		for (int tx = x - x % RENDER_TILE_SIZE; tx < x_end; tx += RENDER_TILE_SIZE) {
+			const int x0 = tx > x ? tx : x;
+			const int x1 = tx + RENDER_TILE_SIZE < x_end ? tx + RENDER_TILE_SIZE : x_end;
+			const float* tile = src->pixels + render_pixel_index(src->columns, tx, ty) * 4;
+			tonemap_pack_tile(tile, x0 - tx, y0 - ty, x1 - tx, y1 - ty, scale, order, dst + (y0 - y) * pitch + (x0 - x) * 4, pitch);
+		}
+	}
+}
+
+void tonemap_pack(const RenderTarget* src, int width, int height, FPType exposure, TonemapOrder order, void* dst, int pitch) {
+	const float scale = (float)(exposure * (FPType)255);
+	tonemap_pack_area(src, 0, 0, width, height, scale, order, dst, pitch);
+}
+
+void tonemap_pack_rect(const RenderTarget* src, int x, int y, int width, int height, FPType exposure, TonemapOrder order, void* dst, int pitch) {
+	const float scale = (float)(exposure * (FPType)255);
+	tonemap_pack_area(src, x, y, width, height, scale, order, (unsigned char*)dst + y * pitch + x * 4, pitch);
+}
+
+int tonemap_save_ppm(const RenderTarget* src, int width, int height, FPType exposure, const char* path) {
+	FILE* f = fopen(path, "wb");
+	if (f == 0) { return 0; }
+	// A row of tiles at a time.
+	unsigned char* rgba = malloc(width * 4 * RENDER_TILE_SIZE);
+	unsigned char* rgb = malloc(width * 3);
+	const float scale = (float)(exposure * (FPType)255);
+	int ok = fprintf(f, "P6\n%d %d\n255\n", width, height) > 0;
+	for (int y = 0; y < height && ok; y += RENDER_TILE_SIZE) {
+		const int rows = y + RENDER_TILE_SIZE <= height ? RENDER_TILE_SIZE : height - y;
+		tonemap_pack_area(src, 0, y, width, rows, scale, TonemapOrder_RGBA, rgba, width * 4);
+		for (int j = 0; j < rows && ok; ++j) {
+			const unsigned char* row = rgba + j * width * 4;
+			for (int x = 0; x < width; ++x) {
+				rgb[x * 3] = row[x * 4];
+				rgb[x * 3 + 1] = row[x * 4 + 1];
+				rgb[x * 3 + 2] = row[x * 4 + 2];
+			}
+			ok = fwrite(rgb, 3, width, f) == (size_t)width;
+		}
+	}
+	free(rgb);
+	free(rgba);
+	return fclose(f) == 0 && ok;
+}
@@ -0,0 +1,36 @@
+/*
+ * tonemap.h
+ *
+ *  Created on: 19/10/2026
+ *      Author: clinton
+ */
+
+#ifndef TONEMAP_H_
+#define TONEMAP_H_
+
+#include "types.h"
+#include "render.h"
+
+// Byte order of the packed pixels.
+typedef enum {
+	TonemapOrder_BGRA, // 32 bit little endian surfaces
+	TonemapOrder_RGBA  // files
+}TonemapOrder;
+
+// Turns the float pixels the renderer writes into 8 bits a channel: each is
+// scaled by exposure, clamped to [0, 1] and rounded to the nearest of 0 to
+// 255, and alpha is always 255. On SSE2, four pixels are converted at a time
+// without branches. dst is width x height, pitch bytes a row, in rows rather
+// than tiles like src. It's filled a tile at a time, so src is read in the
+// order it's stored.
+void tonemap_pack(const RenderTarget* src, int width, int height, FPType exposure, TonemapOrder order, void* dst, int pitch);
+
+// Packs just the width x height pixels from (x, y) into the same place in
+// dst, which is laid out as for tonemap_pack(), giving the same bytes.
+void tonemap_pack_rect(const RenderTarget* src, int x, int y, int width, int height, FPType exposure, TonemapOrder order, void* dst, int pitch);
+
+// Writes src, width x height, to a binary PPM file at path, tone mapped as
+// tonemap_pack() does. Returns non-zero if it was written.
+int tonemap_save_ppm(const RenderTarget* src, int width, int height, FPType exposure, const char* path);
+
+#endif /* TONEMAP_H_ */
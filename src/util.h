@@ -34,4 +34,39 @@ static inline FPType tan_deg(FPType deg) {
 	return tan(deg2rad(deg));
 }
 
+// Mixes the bits of x so that nearby inputs give unrelated outputs, for
+// picking samples without keeping random number state.
+static inline unsigned int hash_uint(unsigned int x) {
+	x ^= x >> 16;
+	x *= 0x7feb352du;
+	x ^= x >> 15;
+	x *= 0x846ca68bu;
+	x ^= x >> 16;
+	return x;
+}
+
+// Hashes three counters together, after the pcg3d hash of Jarzynski and
+// Olano, for random numbers keyed by several indices at once. Any counter
+// changing gives an unrelated result, so numbers keyed this way don't
+// depend on the order they're asked for in.
+static inline unsigned int hash_uint3(unsigned int x, unsigned int y, unsigned int z) {
+	x = x * 1664525u + 1013904223u;
+	y = y * 1664525u + 1013904223u;
+	z = z * 1664525u + 1013904223u;
+	x += y * z;
+	y += z * x;
+	z += x * y;
+	x ^= x >> 16;
+	y ^= y >> 16;
+	z ^= z >> 16;
+	x += y * z;
+	return x;
+}
+
+// Maps a hash to [0, 1). Only the top 24 bits are used, so it's exact in a
+// float.
+static inline FPType hash_unit(unsigned int h) {
+	return (FPType)(h >> 8) / (FPType)16777216;
+}
+
 #endif /* UTIL_H_ */
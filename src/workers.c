@@ -0,0 +1,131 @@
+/*
+ * workers.c
+ *
+ *  Created on: 19/10/2026
+ *      Author: clinton
+ */
+
+#include <malloc.h>
+#include <SDL.h>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+#include "workers.h"
+
+typedef struct {
+	Workers* workers;
+	int index;
+	SDL_Thread* thread;
+}Worker;
+
+struct _Workers {
+	int count;
+	Worker* threads; // count - 1 of them, the caller being worker 0
+	SDL_mutex* mutex;
+	SDL_cond* start;
+	SDL_cond* finish;
+	// Bumped for every run so a thread knows a wake up is for a new one.
+	int generation;
+	int running;
+	int quit;
+	WorkerFn fn;
+	void* data;
+};
+
+static int worker_main(void* data) {
+	Worker* worker = data;
+	Workers* workers = worker->workers;
+	int generation = 0;
+	SDL_LockMutex(workers->mutex);
+	for (;;) {
+		while (!workers->quit && workers->generation == generation) {
+			SDL_CondWait(workers->start, workers->mutex);
+		}
+		if (workers->quit) { break; }
+		generation = workers->generation;
+		WorkerFn fn = workers->fn;
+		void* fn_data = workers->data;
+		SDL_UnlockMutex(workers->mutex);
+		fn(fn_data, worker->index);
+		SDL_LockMutex(workers->mutex);
+		if (--workers->running == 0) {
+			SDL_CondSignal(workers->finish);
+		}
+	}
+	SDL_UnlockMutex(workers->mutex);
+	return 0;
+}
+
+Workers* workers_new(int count) {
+	if (count < 1) { count = 1; }
+	Workers* workers = malloc(sizeof(Workers));
+	workers->count = count;
+	workers->mutex = SDL_CreateMutex();
+	workers->start = SDL_CreateCond();
+	workers->finish = SDL_CreateCond();
+	workers->generation = 0;
+	workers->running = 0;
+	workers->quit = 0;
+	workers->fn = 0;
+	workers->data = 0;
+	workers->threads = malloc(sizeof(Worker) * count);
+	for (int i = 1; i < count; ++i) {
+		Worker* worker = &workers->threads[i - 1];
+		worker->workers = workers;
+		worker->index = i;
+		worker->thread = SDL_CreateThread(worker_main, worker);
+	}
+	return workers;
+}
+
+void workers_free(Workers* workers) {
+	SDL_LockMutex(workers->mutex);
+	workers->quit = 1;
+	SDL_CondBroadcast(workers->start);
+	SDL_UnlockMutex(workers->mutex);
+	for (int i = 1; i < workers->count; ++i) {
+		SDL_WaitThread(workers->threads[i - 1].thread, 0);
+	}
+	SDL_DestroyCond(workers->start);
+	SDL_DestroyCond(workers->finish);
+	SDL_DestroyMutex(workers->mutex);
+	free(workers->threads);
+	free(workers);
+}
+
+int workers_count(const Workers* workers) {
+	return workers->count;
+}
+
+void workers_run(Workers* workers, WorkerFn fn, void* data) {
+	if (workers->count > 1) {
+		SDL_LockMutex(workers->mutex);
+		workers->fn = fn;
+		workers->data = data;
+		workers->running = workers->count - 1;
+		++workers->generation;
+		SDL_CondBroadcast(workers->start);
+		SDL_UnlockMutex(workers->mutex);
+	}
+	fn(data, 0);
+	if (workers->count > 1) {
+		SDL_LockMutex(workers->mutex);
+		while (workers->running > 0) {
+			SDL_CondWait(workers->finish, workers->mutex);
+		}
+		SDL_UnlockMutex(workers->mutex);
+	}
+}
+
+int workers_cpu_count() {
+#ifdef _WIN32
+	SYSTEM_INFO info;
+	GetSystemInfo(&info);
+	return info.dwNumberOfProcessors < 1 ? 1 : (int)info.dwNumberOfProcessors;
+#else
+	long count = sysconf(_SC_NPROCESSORS_ONLN);
+	return count < 1 ? 1 : (int)count;
+#endif
+}
@@ -0,0 +1,29 @@
+/*
+ * workers.h
+ *
+ *  Created on: 19/10/2026
+ *      Author: clinton
+ */
+
+#ifndef WORKERS_H_
+#define WORKERS_H_
+
+// A fixed set of threads that all run the same function at once, for
+// splitting a pass over the frame between the CPUs.
+typedef struct _Workers Workers;
+
+// worker is 0 for the thread that called workers_run() and 1 to count - 1
+// for the others.
+typedef void (*WorkerFn)(void* data, int worker);
+
+// count includes the calling thread, so 1 starts no threads at all.
+Workers* workers_new(int count);
+void workers_free(Workers* workers);
+int workers_count(const Workers* workers);
+
+// Calls fn on every worker and returns once they have all returned.
+void workers_run(Workers* workers, WorkerFn fn, void* data);
+
+int workers_cpu_count();
+
+#endif /* WORKERS_H_ */